@@ -21,9 +21,66 @@
 #include "../../ospray/common/Model.h"
 // ispc exports
 #include "BlurInstance_ispc.h"
+// std
+#include <algorithm>
+#include <cmath>
 
 namespace ospray {
 
+  // embree 2 does not accept more time steps per geometry than this
+  static const int maxEmbreeTimeSteps = 129;
+
+  /*! one motion key in scale/rotation/translation form */
+  struct SRT
+  {
+    vec3f scale;
+    vec4f rotation; // unit quaternion, (x,y,z) imaginary, w real part
+    vec3f translation;
+  };
+  static_assert(sizeof(SRT) == 10*sizeof(float), "unexpected SRT key padding");
+
+  static inline float dot4(const vec4f &a, const vec4f &b)
+  {
+    return a.x*b.x + a.y*b.y + a.z*b.z + a.w*b.w;
+  }
+
+  static inline vec4f normalize4(const vec4f &q)
+  {
+    return q * (1.f / std::sqrt(dot4(q, q)));
+  }
+
+  //! interpolate between unit quaternions along the shorter arc
+  static inline vec4f slerp(const vec4f &q0, const vec4f &_q1, float t)
+  {
+    float cosTheta = dot4(q0, _q1);
+    const vec4f q1 = cosTheta < 0.f ? _q1 * -1.f : _q1;
+    cosTheta = std::abs(cosTheta);
+
+    float w0 = 1.f - t, w1 = t;
+    if (cosTheta < 0.9995f) {
+      const float theta = std::acos(cosTheta);
+      const float rcpSinTheta = 1.f / std::sin(theta);
+      w0 = std::sin((1.f - t) * theta) * rcpSinTheta;
+      w1 = std::sin(t * theta) * rcpSinTheta;
+    }
+    return normalize4(q0 * w0 + q1 * w1);
+  }
+
+  //! rotation angle (radians) between two unit quaternions
+  static inline float angleBetween(const vec4f &q0, const vec4f &q1)
+  {
+    return 2.f * std::acos(std::min(std::abs(dot4(q0, q1)), 1.f));
+  }
+
+  static AffineSpace3f toAffine(const vec3f &s, const vec4f &q, const vec3f &t)
+  {
+    const float x = q.x, y = q.y, z = q.z, w = q.w;
+    const vec3f rx(1.f - 2.f*(y*y + z*z), 2.f*(x*y + w*z), 2.f*(x*z - w*y));
+    const vec3f ry(2.f*(x*y - w*z), 1.f - 2.f*(x*x + z*z), 2.f*(y*z + w*x));
+    const vec3f rz(2.f*(x*z + w*y), 2.f*(y*z - w*x), 1.f - 2.f*(x*x + y*y));
+    return AffineSpace3f(LinearSpace3f(rx * s.x, ry * s.y, rz * s.z), t);
+  }
+
   BlurInstance::BlurInstance()
   {
     this->ispcEquivalent = ispc::BlurInstanceGeometry_create(this);
@@ -37,7 +94,15 @@ namespace ospray {
   void BlurInstance::finalize(Model *model)
   {
     xfmData = getParamData("xfm");
-    if (xfmData)
+    srtData = getParamData("motion.srt");
+    if (srtData)
+    {
+      expandSRT();
+      xfms = srtXfms.data();
+      numTimeSteps = srtXfms.size();
+      xfm = xfms[0];
+    }
+    else if (xfmData)
     {
       switch (xfmData->type) {
       case OSP_FLOAT:   numTimeSteps = xfmData->size() / 12; break;
@@ -71,37 +136,10 @@ namespace ospray {
                                    instancedScene->embreeSceneHandle,
                                    numTimeSteps);
 
-    const box3f b = instancedScene->bounds;
-    if (b.empty()) {
-      // for now, let's just issue a warning since not all ospray
-      // geometries do properly set the boudning box yet. as soon as
-      // this gets fixed we will actually switch to reporting an error
-      static WarnOnce warning("creating an instance to a model that does not"
-                              " have a valid bounding box. epsilons for"
-                              " ray offsets may be wrong");
-    }
-    const vec3f v000(b.lower.x,b.lower.y,b.lower.z);
-    const vec3f v001(b.upper.x,b.lower.y,b.lower.z);
-    const vec3f v010(b.lower.x,b.upper.y,b.lower.z);
-    const vec3f v011(b.upper.x,b.upper.y,b.lower.z);
-    const vec3f v100(b.lower.x,b.lower.y,b.upper.z);
-    const vec3f v101(b.upper.x,b.lower.y,b.upper.z);
-    const vec3f v110(b.lower.x,b.upper.y,b.upper.z);
-    const vec3f v111(b.upper.x,b.upper.y,b.upper.z);
-
-    bounds = empty;
+    computeBounds();
 
     for (int t = 0; t < numTimeSteps; t++)
     {
-      bounds.extend(xfmPoint(xfms[t],v000));
-      bounds.extend(xfmPoint(xfms[t],v001));
-      bounds.extend(xfmPoint(xfms[t],v010));
-      bounds.extend(xfmPoint(xfms[t],v011));
-      bounds.extend(xfmPoint(xfms[t],v100));
-      bounds.extend(xfmPoint(xfms[t],v101));
-      bounds.extend(xfmPoint(xfms[t],v110));
-      bounds.extend(xfmPoint(xfms[t],v111));
-
       rtcSetTransform2(model->embreeSceneHandle,embreeGeomID,
                        RTC_MATRIX_COLUMN_MAJOR,
                        (const float *)&xfms[t], t);
@@ -118,6 +156,104 @@ namespace ospray {
                                &areaPDF[0]);
   }
 
+  static inline box3f xfmBounds(const AffineSpace3f &xfm, const box3f &b)
+  {
+    box3f r = empty;
+    for (int i = 0; i < 8; i++)
+      r.extend(xfmPoint(xfm, vec3f(i & 1 ? b.upper.x : b.lower.x,
+                                   i & 2 ? b.upper.y : b.lower.y,
+                                   i & 4 ? b.upper.z : b.lower.z)));
+    return r;
+  }
+
+  void BlurInstance::computeBounds()
+  {
+    // transforming the box of each instanced geometry is tighter than
+    // transforming the box of the whole model once it gets rotated
+    std::vector<box3f> geomBounds;
+    for (const auto &geom : instancedScene->geometry) {
+      if (geom->bounds.empty()) {
+        geomBounds.clear();
+        break;
+      }
+      geomBounds.push_back(geom->bounds);
+    }
+
+    if (geomBounds.empty()) {
+      if (instancedScene->bounds.empty()) {
+        // for now, let's just issue a warning since not all ospray
+        // geometries do properly set the boudning box yet. as soon as
+        // this gets fixed we will actually switch to reporting an error
+        static WarnOnce warning("creating an instance to a model that does not"
+                                " have a valid bounding box. epsilons for"
+                                " ray offsets may be wrong");
+      }
+      geomBounds.push_back(instancedScene->bounds);
+    }
+
+    // corners move linearly with the blended key matrices, so the union
+    // over all keys also bounds every time in between
+    bounds = empty;
+    for (int t = 0; t < numTimeSteps; t++)
+      for (const auto &b : geomBounds)
+        bounds.extend(xfmBounds(xfms[t], b));
+  }
+
+  void BlurInstance::expandSRT()
+  {
+    if (srtData->type != OSP_FLOAT)
+      throw std::runtime_error("motion.srt must have data type OSP_FLOAT");
+
+    const size_t keySize = sizeof(SRT) / sizeof(float);
+    if (srtData->size() % keySize != 0)
+      throw std::runtime_error("motion.srt size must be a multiple of 10 floats"
+                               " (one scale/rotation/translation key each)");
+
+    const int numKeys = srtData->size() / keySize;
+    if (numKeys < 1)
+      throw std::runtime_error("motion.srt must hold at least one key");
+    if (numKeys > maxEmbreeTimeSteps)
+      throw std::runtime_error("motion.srt holds more keys than embree supports"
+                               " time steps (129)");
+
+    std::vector<SRT> keys((const SRT *)srtData->data,
+                          (const SRT *)srtData->data + numKeys);
+    for (auto &key : keys)
+      key.rotation = normalize4(key.rotation);
+
+    // embree time steps are uniformly spaced, so every segment is split
+    // into the same number of sub-segments, chosen by the fastest one
+    const float maxAngle =
+      getParam1f("motion.srt.maxAngle", 10.f) * (3.14159265f / 180.f);
+    float angle = 0.f;
+    for (int k = 0; k+1 < numKeys; k++)
+      angle = std::max(angle, angleBetween(keys[k].rotation, keys[k+1].rotation));
+
+    int numSub = 1;
+    if (numKeys > 1) {
+      if (maxAngle > 0.f)
+        numSub = std::max(1, int(std::ceil(angle / maxAngle)));
+      // stay within embree's time step limit; keys are never dropped, so
+      // at worst every segment stays a single linear matrix blend
+      numSub = std::max(1, std::min(numSub,
+                                    (maxEmbreeTimeSteps-1) / (numKeys-1)));
+    }
+
+    srtXfms.clear();
+    for (int k = 0; k+1 < numKeys; k++) {
+      const SRT &k0 = keys[k];
+      const SRT &k1 = keys[k+1];
+      for (int i = 0; i < numSub; i++) {
+        const float t = float(i) / numSub;
+        srtXfms.push_back(toAffine((1.f-t)*k0.scale + t*k1.scale,
+                                   slerp(k0.rotation, k1.rotation, t),
+                                   (1.f-t)*k0.translation + t*k1.translation));
+      }
+    }
+    const SRT &last = keys[numKeys-1];
+    srtXfms.push_back(toAffine(last.scale, last.rotation, last.translation));
+  }
+
   OSP_REGISTER_GEOMETRY(BlurInstance, blur_instance);
 
 } // ::ospray
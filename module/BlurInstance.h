@@ -35,8 +35,21 @@ namespace ospray {
     float3 "xfm.l.vz" // 1st column of the affine transformation matrix
     float3 "xfm.p"    // 4th column (translation) of the affine transformation matrix
     OSPModel "model"  // model we're instancing
+    Data<float> "xfm"         // optional, 12 floats (one 3x4 matrix) per motion key
+    Data<float> "motion.srt"  // optional, 10 floats per motion key:
+                              // scale xyz, rotation quaternion xyzw, translation xyz
+    float "motion.srt.maxAngle" // max. rotation (degrees) between expanded keys
     </pre>
 
+    Motion keys given as "motion.srt" are interpolated as scale,
+    rotation and translation (the rotation by quaternion slerp), such
+    that spinning objects do not shrink between keys. As embree blends
+    instance transforms linearly, every segment between two keys is
+    expanded into enough matrix keys that no expanded segment rotates
+    by more than "motion.srt.maxAngle" degrees (default 10), as far as
+    embree's limit of 129 time steps allows; more than 129 keys are
+    rejected.
+
     The functionality for this geometry is implemented via the
     \ref ospray::Instance class.
   */
@@ -67,6 +80,14 @@ namespace ospray {
     uint32        embreeGeomID;
 
     Ref<Data> xfmData;
+    Ref<Data> srtData;
+    /*! matrix keys expanded from "motion.srt" */
+    std::vector<AffineSpace3f> srtXfms;
+
+  private:
+
+    void expandSRT();
+    void computeBounds();
   };
 
 } // ::ospray
@@ -20,10 +20,17 @@
 #include "../include/ospray/ospray.h"
 // ispc exports
 #include "BlurTriangles_ispc.h"
+// ospcommon
+#include "ospcommon/tasking/parallel_for.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 
 #define RTC_INVALID_ID RTC_INVALID_GEOMETRY_ID
 
+// the embree device ospray creates its scenes with
+extern "C" RTCDevice ispc_embreeDevice();
+
 namespace ospray {
 
   inline bool inRange(int64 i, int64 i0, int64 i1)
@@ -31,18 +38,291 @@ namespace ospray {
     return i >= i0 && i < i1;
   }
 
+  /*! the arrays of a Data<OSPData> list of per time step arrays, which all
+      need to be of the same type and size */
+  static std::vector<Data *> stepArrays(const Ref<Data> &list, const char *name)
+  {
+    std::vector<Data *> steps((Data **)list->data,
+                              (Data **)list->data + list->numItems);
+    if (steps.empty())
+      throw std::runtime_error(std::string(name) + " list holds no time steps");
+    for (Data *step : steps) {
+      if (!step || step->type != steps[0]->type
+          || step->numItems != steps[0]->numItems)
+        throw std::runtime_error(std::string(name) + " list time steps must"
+                                 " be arrays of the same type and size");
+    }
+    return steps;
+  }
+
+  static inline bool isDataList(const Ref<Data> &data)
+  {
+    return data && (data->type == OSP_DATA || data->type == OSP_OBJECT);
+  }
+
   BlurTriangles::BlurTriangles()
-    : eMesh(RTC_INVALID_ID)
+    : eMesh(RTC_INVALID_ID),
+      dynamicScene(nullptr),
+      dynamicMesh(RTC_INVALID_ID)
   {
     this->ispcMaterialPtrs = nullptr;
     this->ispcEquivalent = ispc::BlurTriangles_create(this);
   }
 
+  BlurTriangles::~BlurTriangles()
+  {
+    if (dynamicScene)
+      rtcDeleteScene(dynamicScene);
+  }
+
   std::string BlurTriangles::toString() const
   {
     return "ospray::BlurTriangles";
   }
 
+  void BlurTriangles::computeBounds(size_t numVerts, size_t numCompsInVtx)
+  {
+    // blocks are small enough for 32-bit offsets on the ISPC side
+    const size_t blockSize = 64*1024;
+    const size_t numBlocks = (numVerts + blockSize - 1) / blockSize;
+    std::vector<box3f> blockBounds(numTimeSteps * numBlocks, box3f(empty));
+
+    tasking::parallel_for(int(numTimeSteps * numBlocks), [&](int taskIndex) {
+      const size_t t = taskIndex / numBlocks;
+      const size_t begin = (taskIndex % numBlocks) * blockSize;
+      const size_t end = std::min(begin + blockSize, numVerts);
+      box3f &b = blockBounds[taskIndex];
+      ispc::BlurTriangles_computeBounds(vertex[t] + begin*numCompsInVtx,
+                                        numCompsInVtx,
+                                        end - begin,
+                                        (ispc::vec3f&)b.lower,
+                                        (ispc::vec3f&)b.upper);
+    });
+
+    timeStepBounds.assign(numTimeSteps, box3f(empty));
+    bounds = empty;
+    for (int t = 0; t < numTimeSteps; t++) {
+      for (size_t i = 0; i < numBlocks; i++)
+        timeStepBounds[t].extend(blockBounds[t*numBlocks + i]);
+      bounds.extend(timeStepBounds[t]);
+    }
+  }
+
+  void BlurTriangles::clearKeyFrames()
+  {
+    keyFrames.clear();
+    keyFramesBaseData = nullptr;
+    keyFramesDeltaData = nullptr;
+    keyFramesMaskData = nullptr;
+  }
+
+  void BlurTriangles::reconstructKeyFrames(size_t numVerts, size_t numCompsInVtx)
+  {
+    const uint8_t *mask = vertexDeltaMaskData ?
+                          (const uint8_t*)vertexDeltaMaskData->data : nullptr;
+    if (mask && vertexDeltaMaskData->size() != numVerts)
+      throw std::runtime_error("vertex.delta.mask must have one entry per vertex");
+
+    size_t numMoving = numVerts;
+    if (mask)
+      numMoving = std::count_if(mask, mask + numVerts,
+                                [](uint8_t m) { return m != 0; });
+
+    if (vertexDeltaData->size() != (numTimeSteps-1)*numMoving)
+      throw std::runtime_error("vertex.delta must hold one delta per moving "
+                               "vertex for every time step after the first");
+
+    // the first key frame is the base itself, only the later ones are built
+    const size_t stepSize = numVerts*numCompsInVtx;
+    const float *base = (const float*)vertexData->data;
+    const vec3f *delta = (const vec3f*)vertexDeltaData->data;
+
+    keyFrames.resize((numTimeSteps-1)*stepSize);
+
+    for (int t = 1; t < numTimeSteps; t++) {
+      float *dst = keyFrames.data() + (t-1)*stepSize;
+      std::copy(base, base + stepSize, dst);
+      for (size_t i = 0; i < numVerts; i++) {
+        if (mask && !mask[i])
+          continue;
+        (vec3f&)dst[i*numCompsInVtx] += *delta++;
+      }
+    }
+
+    keyFramesBaseData = vertexData;
+    keyFramesDeltaData = vertexDeltaData;
+    keyFramesMaskData = vertexDeltaMaskData;
+  }
+
+  uint32 BlurTriangles::commitDynamicMesh(Model *model,
+                                          size_t numTris,
+                                          size_t numVerts)
+  {
+    const size_t vertexStride = sizeOf(vertexData->type);
+    const bool refit = dynamicScene
+      && dynamicIndexData.ptr == indexData.ptr
+      && dynamicNumVerts == numVerts
+      && dynamicNumTimeSteps == numTimeSteps
+      && dynamicVertexStride == vertexStride;
+
+    if (!refit) {
+      if (dynamicScene)
+        rtcDeleteScene(dynamicScene);
+      dynamicScene = rtcDeviceNewScene(ispc_embreeDevice(),
+                                       RTC_SCENE_DYNAMIC,
+                                       RTC_INTERSECT_UNIFORM|RTC_INTERSECT_VARYING);
+      dynamicMesh = rtcNewTriangleMesh(dynamicScene,RTC_GEOMETRY_DEFORMABLE,
+                                       numTris,numVerts,numTimeSteps);
+      rtcSetBuffer(dynamicScene,dynamicMesh,RTC_INDEX_BUFFER,
+                   (void*)this->index,0,
+                   sizeOf(indexData->type));
+
+      dynamicIndexData = indexData;
+      dynamicNumVerts = numVerts;
+      dynamicNumTimeSteps = numTimeSteps;
+      dynamicVertexStride = vertexStride;
+    }
+
+    for (int t = 0; t < numTimeSteps; t++)
+    {
+      const RTCBufferType buffer = (RTCBufferType)(RTC_VERTEX_BUFFER+t);
+      rtcSetBuffer(dynamicScene,dynamicMesh,buffer,
+                   (void*)(this->vertex[t]),0,vertexStride);
+      if (refit)
+        rtcUpdateBuffer(dynamicScene,dynamicMesh,buffer);
+    }
+
+    // with only the vertex buffers modified embree refits the BVH
+    rtcCommit(dynamicScene);
+
+    const uint32 instance = rtcNewInstance2(model->embreeSceneHandle,
+                                            dynamicScene,1);
+    const AffineSpace3f identity(one);
+    rtcSetTransform2(model->embreeSceneHandle,instance,
+                     RTC_MATRIX_COLUMN_MAJOR,(const float *)&identity,0);
+    return instance;
+  }
+
+  void BlurTriangles::sliceShutter(size_t numVerts, size_t numCompsInVtx)
+  {
+    const int numSegments = numTimeSteps - 1;
+    float open = shutter.x * numSegments;
+    float close = shutter.y * numSegments;
+    const int first = std::min(int(std::floor(open)), numSegments);
+    const int last = std::max(int(std::ceil(close)), first);
+
+    // the key frames inside the window are kept as they are, its ends get
+    // interpolated key frames. embree needs uniformly spaced key frames,
+    // which only holds if the window lies within one segment, is centered
+    // on its only inner key frame, or starts and ends on key frames
+    const int numInner = std::max(last - first - 1, 0);
+    const float head = first + 1 - open;
+    const float tail = close - (last - 1);
+    const bool uniform = numInner == 0
+      || (numInner == 1 && std::abs(head - tail) <= 1e-4f)
+      || (open == first && close == last);
+    if (!uniform) {
+      static WarnOnce warning("blur_triangles shutter window does not fall onto"
+                              " uniformly spaced key frames, widening it to the"
+                              " enclosing key frames");
+      open = first;
+      close = last;
+      shutter = vec2f(open, close) / float(numSegments);
+    }
+
+    // key frame times of the window, in key frame units
+    std::vector<float> times(1, open);
+    if (shutter.x != shutter.y) {
+      for (int t = first + 1; t < last; t++)
+        times.push_back(t);
+      times.push_back(close);
+    }
+
+    const size_t stepSize = numVerts*numCompsInVtx;
+    const int numInterpolated =
+      std::count_if(times.begin(), times.end(),
+                    [](float f) { return f != std::floor(f); });
+    shutterKeyFrames.resize(numInterpolated*stepSize);
+
+    std::vector<const float *> sliced;
+    float *dst = shutterKeyFrames.data();
+    for (const float f : times) {
+      if (f == std::floor(f)) {
+        sliced.push_back(vertex[int(f)]);
+        continue;
+      }
+
+      const int t0 = std::min(int(f), numSegments-1);
+      const float w1 = f - t0;
+      const float *v0 = vertex[t0];
+      const float *v1 = vertex[t0+1];
+      const size_t blockSize = 64*1024;
+      const size_t numBlocks = (stepSize + blockSize - 1) / blockSize;
+      tasking::parallel_for(int(numBlocks), [&](int block) {
+        const size_t begin = block * blockSize;
+        const size_t end = std::min(begin + blockSize, stepSize);
+        for (size_t j = begin; j < end; j++)
+          dst[j] = (1.f - w1)*v0[j] + w1*v1[j];
+      });
+      sliced.push_back(dst);
+      dst += stepSize;
+    }
+
+    vertex = sliced;
+    numTimeSteps = sliced.size();
+  }
+
+  void BlurTriangles::decimateTimeSteps(size_t numVerts, size_t numCompsInVtx,
+                                        float tolerance)
+  {
+    // embree needs uniformly spaced time steps, so only keep every s-th
+    // key frame, for the largest s dividing the segments whose linear
+    // interpolation reproduces all dropped key frames within 'tolerance'
+    const int numSegments = numTimeSteps - 1;
+    const float tolerance2 = tolerance * tolerance;
+    const size_t blockSize = 16*1024;
+    const size_t numBlocks = (numVerts + blockSize - 1) / blockSize;
+
+    for (int s = numSegments; s > 1; s--) {
+      if (numSegments % s)
+        continue;
+
+      std::atomic<bool> fits(true);
+      if (!std::isinf(tolerance)) {
+        tasking::parallel_for(int(numBlocks), [&](int block) {
+          const size_t begin = block * blockSize;
+          const size_t end = std::min(begin + blockSize, numVerts);
+          for (int t = 0; t < numSegments && fits; t++) {
+            if (t % s == 0)
+              continue;
+            const float w1 = float(t % s) / s;
+            const float *v0 = vertex[t - t % s];
+            const float *v1 = vertex[t - t % s + s];
+            const float *v = vertex[t];
+            for (size_t i = begin; i < end; i++) {
+              const vec3f &a = (const vec3f&)v0[i*numCompsInVtx];
+              const vec3f &b = (const vec3f&)v1[i*numCompsInVtx];
+              const vec3f d = (1.f - w1)*a + w1*b - (const vec3f&)v[i*numCompsInVtx];
+              if (dot(d, d) > tolerance2) {
+                fits = false;
+                break;
+              }
+            }
+          }
+        });
+      }
+
+      if (fits) {
+        std::vector<const float *> kept;
+        for (int t = 0; t <= numSegments; t += s)
+          kept.push_back(vertex[t]);
+        vertex = kept;
+        numTimeSteps = kept.size();
+        return;
+      }
+    }
+  }
+
   void BlurTriangles::finalize(Model *model)
   {
     static int numPrints = 0;
@@ -63,20 +343,53 @@ namespace ospray {
     normalData = getParamData("vertex.normal",getParamData("normal"));
     colorData  = getParamData("vertex.color",getParamData("color"));
     texcoordData = getParamData("vertex.texcoord",getParamData("texcoord"));
+    attributeData = getParamData("vertex.attributes");
     indexData  = getParamData("index",getParamData("triangle"));
+    vertexDeltaData = getParamData("vertex.delta");
+    vertexDeltaMaskData = getParamData("vertex.delta.mask");
     prim_materialIDData = getParamData("prim.materialID");
     materialListData = getParamData("materialList");
     geom_materialID = getParam1i("geom.materialID",-1);
+    areaTime = getParam1f("area.time",-1.f);
 
     numTimeSteps = getParam1i("vertex.timesteps", getParam1i("positionTimeSteps", 1));
     int numNormalTimeSteps = getParam1i("normal.timesteps", getParam1i("normalTimeSteps", 1));
 
+    // time steps given as a list of per step arrays instead of packed
+    std::vector<Data *> vertexSteps, normalSteps;
+    if (isDataList(vertexData)) {
+      vertexSteps = stepArrays(vertexData, "vertex");
+      vertexListData = vertexData;
+      vertexData = vertexSteps[0];
+      numTimeSteps = vertexSteps.size();
+    } else
+      vertexListData = nullptr;
+    if (isDataList(normalData)) {
+      normalSteps = stepArrays(normalData, "vertex.normal");
+      normalListData = normalData;
+      normalData = normalSteps[0];
+      numNormalTimeSteps = normalSteps.size();
+    } else
+      normalListData = nullptr;
+
+    const size_t vertexStepStride = getParam1i("vertex.timesteps.stride", 0);
+    const size_t normalStepStride = getParam1i("normal.timesteps.stride", 0);
+    shutter.x = getParam1f("shutterOpen", 0.f);
+    shutter.y = getParam1f("shutterClose", 1.f);
+
     if (!vertexData)
       throw std::runtime_error("triangle mesh must have 'vertex' array");
     if (!indexData)
       throw std::runtime_error("triangle mesh must have 'index' array");
+    if (vertexDeltaData && vertexDeltaData->type != OSP_FLOAT3)
+      throw std::runtime_error("vertex.delta must have data type OSP_FLOAT3");
+    if (vertexDeltaMaskData && vertexDeltaMaskData->type != OSP_UCHAR)
+      throw std::runtime_error("vertex.delta.mask must have data type OSP_UCHAR");
     if (colorData && colorData->type != OSP_FLOAT4 && colorData->type != OSP_FLOAT3A)
       throw std::runtime_error("vertex.color must have data type OSP_FLOAT4 or OSP_FLOAT3A");
+    if (!(0.f <= shutter.x && shutter.x <= shutter.y && shutter.y <= 1.f))
+      throw std::runtime_error("triangle mesh shutter window must satisfy "
+                               "0 <= shutterOpen <= shutterClose <= 1");
 
     // check whether we need 64-bit addressing
     bool huge_mesh = false;
@@ -90,13 +403,23 @@ namespace ospray {
       huge_mesh = true;
     if (texcoordData && texcoordData->numBytes > INT32_MAX)
       huge_mesh = true;
+    if (attributeData && attributeData->numBytes > INT32_MAX)
+      huge_mesh = true;
 
     this->index = (int*)indexData->data;
     //this->vertex = (float*)vertexData->data;
     //this->normal = normalData ? (float*)normalData->data : nullptr;
-    this->color  = colorData ? (vec4f*)colorData->data : nullptr;
-    this->texcoord = texcoordData ? (vec2f*)texcoordData->data : nullptr;
-    this->prim_materialID  = prim_materialIDData ? (uint32_t*)prim_materialIDData->data : nullptr;
+    this->color  = colorData ? (float*)colorData->data : nullptr;
+    this->texcoord = texcoordData ? (float*)texcoordData->data : nullptr;
+    this->prim_materialID = nullptr;
+    this->prim_materialID16 = nullptr;
+    if (prim_materialIDData) switch (prim_materialIDData->type) {
+    case OSP_INT:
+    case OSP_UINT:   prim_materialID = (uint32*)prim_materialIDData->data; break;
+    case OSP_USHORT: prim_materialID16 = (uint16*)prim_materialIDData->data; break;
+    default:
+      throw std::runtime_error("prim.materialID must have data type OSP_UINT or OSP_USHORT");
+    }
     this->materialList  = materialListData ? (ospray::Material**)materialListData->data : nullptr;
 
     if (materialList && !ispcMaterialPtrs) {
@@ -114,6 +437,10 @@ namespace ospray {
     size_t numCompsInTri = 0;
     size_t numCompsInVtx = 0;
     size_t numCompsInNor = 0;
+    size_t numCompsInCol = 4;
+    size_t numCompsInTex = 2;
+    bool octNormals = false;
+    bool hasAlpha = colorData && colorData->type == OSP_FLOAT4;
     switch (indexData->type) {
     case OSP_INT:
     case OSP_UINT:  numTris = indexData->size() / 3; numCompsInTri = 3; break;
@@ -134,68 +461,183 @@ namespace ospray {
       throw std::runtime_error("unsupported trianglemesh.vertex data type");
     }
 
-    numVerts /= numTimeSteps;
+    this->vertex.clear();
+    this->normal.clear();
+
+    if (vertexDeltaData) {
+      // 'vertex' only holds the base key frame; embree needs every key frame
+      // as a full vertex buffer, so rebuild them from the deltas, unless a
+      // re-commit (e.g. for a new shutter window) keeps all of the inputs
+      const bool reuseKeyFrames = keyFramesBaseData.ptr == vertexData.ptr
+        && keyFramesDeltaData.ptr == vertexDeltaData.ptr
+        && keyFramesMaskData.ptr == vertexDeltaMaskData.ptr
+        && keyFrames.size() == (numTimeSteps-1)*numVerts*numCompsInVtx;
+      if (!reuseKeyFrames)
+        reconstructKeyFrames(numVerts, numCompsInVtx);
+      this->vertex.push_back((float*)vertexData->data);
+      for (int t = 1; t < numTimeSteps; t++)
+        this->vertex.push_back(keyFrames.data() + (t-1)*numVerts*numCompsInVtx);
+    } else if (!vertexSteps.empty()) {
+      clearKeyFrames();
+      for (Data *step : vertexSteps)
+        this->vertex.push_back((float*)step->data);
+    } else if (vertexStepStride) {
+      // time steps at a constant byte distance within one (shared) buffer
+      clearKeyFrames();
+      const size_t vertexSize = numCompsInVtx*sizeof(float);
+      if (vertexStepStride % sizeof(float)
+          || vertexData->numBytes < (numTimeSteps-1)*vertexStepStride)
+        throw std::runtime_error("invalid vertex.timesteps.stride");
+      numVerts = (vertexData->numBytes - (numTimeSteps-1)*vertexStepStride) / vertexSize;
+      if (numTimeSteps > 1 && vertexStepStride < numVerts*vertexSize)
+        throw std::runtime_error("vertex.timesteps.stride is smaller than a time step");
+
+      for (int t = 0; t < numTimeSteps; t++)
+        this->vertex.push_back((float*)((char*)vertexData->data + t*vertexStepStride));
+    } else {
+      clearKeyFrames();
+      numVerts /= numTimeSteps;
+
+      for (int t = 0; t < numTimeSteps; t++)
+        this->vertex.push_back((float*)vertexData->data + t*numVerts*numCompsInVtx);
+    }
 
-    for (int t = 0; t < numTimeSteps; t++)
-      this->vertex.push_back((float*)vertexData->data + t*numVerts*numCompsInVtx);
+    if (numTimeSteps > 1 && (shutter.x != 0.f || shutter.y != 1.f))
+      sliceShutter(numVerts, numCompsInVtx);
+    else
+      shutterKeyFrames.clear();
+
+    const float timeStepTolerance = getParam1f("vertex.timesteps.tolerance", 0.f);
+    if (numTimeSteps > 2 && timeStepTolerance > 0.f)
+      decimateTimeSteps(numVerts, numCompsInVtx, timeStepTolerance);
 
     if (normalData) switch (normalData->type) {
     case OSP_FLOAT3:  numCompsInNor = 3; break;
     case OSP_FLOAT:
     case OSP_FLOAT3A: numCompsInNor = 4; break;
+    case OSP_UINT:    numCompsInNor = 1; octNormals = true; break;
     default:
       throw std::runtime_error("unsupported trianglemesh.vertex.normal data type");
     }
 
-    if (normalData) {
+    if (!normalSteps.empty()) {
+      if (normalData->numBytes < numVerts*numCompsInNor*sizeof(float))
+        throw std::runtime_error("vertex.normal list holds too few normals per time step");
+      for (Data *step : normalSteps)
+        this->normal.push_back((float*)step->data);
+    } else if (normalData) {
+      const size_t normalSize = numCompsInNor*sizeof(float);
+      const size_t stride = normalStepStride ? normalStepStride : numVerts*normalSize;
+      if (stride % sizeof(float)
+          || normalData->numBytes < (numNormalTimeSteps-1)*stride + numVerts*normalSize)
+        throw std::runtime_error("vertex.normal holds too few normals for its time steps");
+
       for (int t = 0; t < numNormalTimeSteps; t++)
-        this->normal.push_back((float*)normalData->data + t*numVerts*numCompsInNor);
+        this->normal.push_back((float*)((char*)normalData->data + t*stride));
     }
 
-    eMesh = rtcNewTriangleMesh(embreeSceneHandle,RTC_GEOMETRY_STATIC,
-                               numTris,numVerts,numTimeSteps);
-
-    for (int t = 0; t < numTimeSteps; t++)
-    {
-      rtcSetBuffer(embreeSceneHandle,eMesh,(RTCBufferType)(RTC_VERTEX_BUFFER+t),
-                   (void*)(this->vertex[t]),0,
-                   sizeOf(vertexData->type));
+    if (attributeData) {
+      // interleaved per-vertex records; an attribute found in here replaces
+      // the separate array of the same kind
+      const int stride = getParam1i("vertex.attributes.stride", 0);
+      const int normalOfs = getParam1i("vertex.attributes.normal", -1);
+      const int colorOfs = getParam1i("vertex.attributes.color", -1);
+      const int texcoordOfs = getParam1i("vertex.attributes.texcoord", -1);
+
+      if (attributeData->type != OSP_FLOAT)
+        throw std::runtime_error("vertex.attributes must have data type OSP_FLOAT");
+      if (stride <= 0 || attributeData->size() < numVerts*stride)
+        throw std::runtime_error("vertex.attributes must hold one record of "
+                                 "'vertex.attributes.stride' floats per vertex");
+      // absent attributes have offset -1
+      auto exceeds = [&](int ofs, int size) { return ofs >= 0 && ofs + size > stride; };
+      if (exceeds(normalOfs, 3) || exceeds(colorOfs, 4) || exceeds(texcoordOfs, 2))
+        throw std::runtime_error("vertex.attributes offsets exceed the record stride");
+
+      const float *attributes = (const float*)attributeData->data;
+      if (normalOfs >= 0) {
+        this->normal.assign(1, attributes + normalOfs);
+        numNormalTimeSteps = 1;
+        numCompsInNor = stride;
+        octNormals = false;
+      }
+      if (colorOfs >= 0) {
+        this->color = attributes + colorOfs;
+        numCompsInCol = stride;
+        hasAlpha = true;
+      }
+      if (texcoordOfs >= 0) {
+        this->texcoord = attributes + texcoordOfs;
+        numCompsInTex = stride;
+      }
     }
 
-    rtcSetBuffer(embreeSceneHandle,eMesh,RTC_INDEX_BUFFER,
-                 (void*)this->index,0,
-                 sizeOf(indexData->type));
+    if (getParam1i("dynamic", 0)) {
+      eMesh = commitDynamicMesh(model, numTris, numVerts);
+    } else {
+      if (dynamicScene) {
+        rtcDeleteScene(dynamicScene);
+        dynamicScene = nullptr;
+        dynamicIndexData = nullptr;
+      }
 
-    bounds = empty;
+      eMesh = rtcNewTriangleMesh(embreeSceneHandle,RTC_GEOMETRY_STATIC,
+                                 numTris,numVerts,numTimeSteps);
 
-    for (int t = 0; t < numTimeSteps; t++) {
-      for (uint32_t i = 0; i < numVerts*numCompsInVtx; i+=numCompsInVtx)
-        bounds.extend(*(vec3f*)(vertex[t] + i));
+      for (int t = 0; t < numTimeSteps; t++)
+      {
+        rtcSetBuffer(embreeSceneHandle,eMesh,(RTCBufferType)(RTC_VERTEX_BUFFER+t),
+                     (void*)(this->vertex[t]),0,
+                     sizeOf(vertexData->type));
+      }
+
+      rtcSetBuffer(embreeSceneHandle,eMesh,RTC_INDEX_BUFFER,
+                   (void*)this->index,0,
+                   sizeOf(indexData->type));
     }
 
+    computeBounds(numVerts, numCompsInVtx);
+
     if (numPrints < 5) {
       postStatusMsg(2) << "  created triangle mesh (" << numTris << " tris "
                        << ", " << numVerts << " vertices)\n"
                        << "  mesh bounds " << bounds;
     }
 
+    // 4-wide indices carry the per-triangle material ID in their 4th
+    // component only if asked for, as importers also pad it or use it
+    // for other data
+    int index_materialID = -1;
+    if (numCompsInTri == 4 && !prim_materialIDData && geom_materialID < 0)
+      index_materialID = getParam1i("index.materialID.shift", -1);
+
     ispc::BlurTriangles_set(getIE(),model->getIE(),eMesh,
                            numTris,
                            numTimeSteps,
+                           numNormalTimeSteps,
                            numCompsInTri,
                            numCompsInVtx,
                            numCompsInNor,
+                           numCompsInCol,
+                           numCompsInTex,
                            (int*)index,
                            (float**)vertex.data(),
-                           normalData ? (float**)normal.data() : nullptr,
-                           (ispc::vec4f*)color,
-                           (ispc::vec2f*)texcoord,
+                           normal.empty() ? nullptr : (float**)normal.data(),
+                           (float*)color,
+                           (float*)texcoord,
                            geom_materialID,
                            getMaterial()?getMaterial()->getIE():nullptr,
                            ispcMaterialPtrs,
+                           materialListData ? materialListData->numItems : 0,
                            (uint32_t*)prim_materialID,
-                           colorData && colorData->type == OSP_FLOAT4,
-                           huge_mesh);
+                           (uint16_t*)prim_materialID16,
+                           index_materialID,
+                           hasAlpha,
+                           octNormals,
+                           huge_mesh,
+                           areaTime,
+                           shutter.x,
+                           shutter.y);
   }
 
   OSP_REGISTER_GEOMETRY(BlurTriangles, blur_triangles);
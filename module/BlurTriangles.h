@@ -18,6 +18,8 @@
 
 #include "../../ospray/geometry/Geometry.h"
 #include "../../ospray/common/Data.h"
+// embree
+#include "embree2/rtcore.h"
 
 namespace ospray {
 
@@ -35,14 +37,39 @@ namespace ospray {
     Data<vec3f> or Data<vec3fa> "position"        // vertex array
     Data<vec3i> or Data<vec3ia> "index"           // index array (three int32 values per triangles)
                                                   // each int32 value is index into the vertex arrays
+    Data<vec3f>                 "vertex.delta"    // per time step offsets of moving vertices
+                                                  // against the base key frame in "vertex"
+    Data<uchar>                 "vertex.delta.mask" // optional, nonzero for moving vertices
     Data<vec3f> or Data<vec3fa> "normal"          // vertex normals
+    Data<uint32>                "normal"          // oct-encoded vertex normals (2x snorm16)
     Data<vec4f>                 "color"           // vertex colors
     Data<vec2f>                 "texcoord"        // texture coordinates
+    Data<float>                 "vertex.attributes" // interleaved per-vertex attribute records
+    int32                       "vertex.attributes.stride"   // floats per record
+    int32                       "vertex.attributes.normal"   // offset of normal in a record, or -1
+    int32                       "vertex.attributes.color"    // offset of color in a record, or -1
+    int32                       "vertex.attributes.texcoord" // offset of texcoord in a record, or -1
+    int32                       "vertex.timesteps.stride" // bytes between time steps in "vertex", 0: packed
+    float                       "vertex.timesteps.tolerance" // max. deviation of dropped time steps
+    int32                       "normal.timesteps.stride" // bytes between time steps in "normal", 0: packed
+    float                       "area.time"       // shutter time at which light sampling
+                                                  // uses the mesh, <0 averages the areas over
+                                                  // the shutter and samples points mid-shutter
+    int32                       "dynamic"         // refit instead of rebuild on re-commit
+    float                       "shutterOpen"     // start of the animation time range to build
+    float                       "shutterClose"    // end of the animation time range to build
     uint32                      "geom.materialID" // material ID for the whole mesh
-    Data<uint32>                "prim.materialID" // per triangle materials, indexing into "materialList"
+    Data<uint32> or Data<uint16> "prim.materialID" // per triangle materials, indexing into "materialList"
+    int32                       "index.materialID.shift" // read material IDs from index.w, shifted down by this many bits
     Data<OSPMaterial>           "materialList"    // list of OSPMaterial pointers
     </pre>
 
+    OSPRay's generic sampleArea hook passes no ray time, so points for
+    area lights are always sampled at "area.time" (mid-shutter if that
+    is negative), not at the time of the shading ray. Renderers that
+    know the ray time can call BlurTriangles_sampleAreaAtTime (declared
+    in BlurTriangles.ih) instead.
+
     The functionality for this geometry is implemented via the
     \ref ospray::BlurTriangles class.
   */
@@ -55,47 +82,150 @@ namespace ospray {
     "trianglemesh", and has several parameters to specify its contained
     triangles; they are specified via data arrays of the proper form:
       -  a 'position' array (Data<vec3f> or Data<vec3fa> type)
-      -  a 'normal' array (Data<vec3f> or Data<vec3fa> type)
+      -  a 'normal' array (Data<vec3f> or Data<vec3fa> type, or Data<uint32>
+         holding oct-encoded unit normals as two 16-bit snorm values)
       -  a 'color' array (Data<vec4f> type)
       -  a 'texcoord' array (Data<vec2f> type)
       -  an 'index' array (Data<vec3i> or Data<vec3ia> type)
 
+    Deforming meshes can be given in a delta layout: 'position' then only
+    holds the first key frame, and 'vertex.delta' (Data<vec3f> type) holds
+    the offsets of every later time step against it. An optional
+    'vertex.delta.mask' (Data<uchar> type, one entry per vertex) marks the
+    vertices that move; deltas are then only stored for those. The delta
+    layout only makes the data smaller to store and to hand over: embree
+    needs full key frames, which are rebuilt at commit (and reused by
+    re-commits that keep 'position' and the deltas), so the committed
+    mesh takes more memory than with packed time steps.
+
+    Normals, colors and texture coordinates can alternatively be
+    interleaved into one 'vertex.attributes' array (Data<float> type) of
+    'vertex.attributes.stride' floats per vertex, so that shading fetches
+    all attributes of a vertex from the same cache line. The offsets of the
+    attributes within a record are given by 'vertex.attributes.normal',
+    '.color' and '.texcoord' (-1 if absent); interleaved attributes replace
+    the separate arrays of the same kind and hold a single time step.
+
+    Multiple time steps of positions and normals are by default packed
+    back to back. Alternatively, 'vertex' and 'normal' can be a
+    Data<OSPData> list of one array per time step (all of the same type
+    and size), which then also determines the number of time steps. If
+    they lie at a constant distance with gaps in between (e.g. when
+    sharing a mapped file), 'vertex.timesteps.stride' and
+    'normal.timesteps.stride' give that distance in bytes; the data then
+    spans from the start of the first to the end of the last time step.
+
+    With a 'vertex.timesteps.tolerance' > 0, key frames are dropped at
+    commit time where linear interpolation between the remaining ones
+    reproduces them within that (object space) distance; as embree needs
+    uniformly spaced key frames, every s-th key frame is kept, for the
+    largest such s dividing the number of segments. An infinite
+    tolerance keeps only the first and the last key frame.
+
+    By default the 'vertex.timesteps' key frames are spread over the full
+    ray time range [0,1]. If 'shutterOpen'/'shutterClose' select a narrower
+    window of the animation, only the key frames inside that window are
+    handed to embree, plus key frames interpolated at its ends where
+    these do not fall onto key frames, and ray time [0,1] is relative to
+    the window; the camera shutter then should be [0,1]. As embree needs
+    uniformly spaced key frames, the window must lie within one segment
+    between key frames, be centered on its only inner key frame, or
+    start and end on key frames; any other window is widened to the
+    enclosing key frames, with a warning. A window of zero length builds
+    a static mesh.
+
+    A 'dynamic' mesh lives in its own embree scene of deformable
+    geometry, instanced into the model. Re-committing it with new vertex
+    data but the same 'index' data, vertex count and time steps refits
+    the existing BVH instead of building a new one. As embree supports
+    a single level of instancing only, a dynamic mesh must not be part
+    of an instanced model.
+
     Indices specified in the 'index' array refer into the vertex arrays;
     each value is the index of a _vertex_ (it, not a byte-offset, nor an
     index into a float array, but an index into an array of vertices).
 
     Materials can be set either via 'geom.materialID' (uint32 type) for
     the whole mesh, or per triangle via
-      - a 'prim.materialID' array (Data<uint32> type), indexing into
+      - a 'prim.materialID' array (Data<uint32> or Data<uint16> type), or
+        the 4th component of 4-wide indices (if 'index.materialID.shift'
+        is set and neither 'prim.materialID' nor 'geom.materialID' is),
+        indexing into
       - a 'materialList' array (holding the OSPMaterial pointers)
+    'index.materialID.shift' gives the bits the material ID sits above in
+    the 4th index component (e.g. 16 for RIVL scenes, 0 if it is all of
+    it); without it the 4th component is ignored. Material IDs beyond
+    the 'materialList' use its last material.
    */
   struct OSPRAY_SDK_INTERFACE BlurTriangles : public Geometry
   {
     BlurTriangles();
-    virtual ~BlurTriangles() = default;
+    virtual ~BlurTriangles();
     virtual std::string toString() const override;
     virtual void finalize(Model *model) override;
 
+    /*! bounds of the vertices of time step 't' */
+    box3f getTimeStepBounds(int t) const { return timeStepBounds[t]; }
+
+    /*! compute per time step bounds and their union in parallel */
+    void computeBounds(size_t numVerts, size_t numCompsInVtx);
+
+    /*! rebuild full key frames from the base key frame and the deltas */
+    void reconstructKeyFrames(size_t numVerts, size_t numCompsInVtx);
+    /*! drop the key frames rebuilt from vertex.delta */
+    void clearKeyFrames();
+
+    /*! update (refit) or build the private scene of a dynamic mesh and
+        instance it into 'model', returns the instance's geometry ID */
+    uint32 commitDynamicMesh(Model *model, size_t numTris, size_t numVerts);
+
+    /*! drop key frames reproduced by interpolation within 'tolerance' */
+    void decimateTimeSteps(size_t numVerts, size_t numCompsInVtx, float tolerance);
+
+    /*! restrict the key frames to the shutter window */
+    void sliceShutter(size_t numVerts, size_t numCompsInVtx);
+
     const int    *index;  //!< mesh's triangle index array
     std::vector<const float *> vertex; //!< mesh's vertex arrays
     std::vector<const float *> normal; //!< mesh's vertex normal arrays
-    const vec4f  *color;  //!< mesh's vertex color array
-    const vec2f  *texcoord; //!< mesh's vertex texcoord array
+    const float  *color;  //!< mesh's vertex color array
+    const float  *texcoord; //!< mesh's vertex texcoord array
     const uint32 *prim_materialID; //!< per-primitive material ID
+    const uint16 *prim_materialID16; //!< per-primitive 16-bit material ID
     Material **materialList; //!< per-primitive material list
     int geom_materialID;
+    float areaTime; //!< time of light sampling, <0: average areas, sample mid-shutter
 
     int numTimeSteps;
+    vec2f shutter; //!< animation time window to build, (0,1) for all of it
 
     Ref<Data> indexData;  /*!< triangle indices (A,B,C,materialID) */
     Ref<Data> vertexData; /*!< vertex position (vec3fa) */
+    Ref<Data> vertexDeltaData; /*!< per time step vertex deltas (vec3f) */
+    Ref<Data> vertexDeltaMaskData; /*!< per vertex 'moves' flags (uchar) */
     Ref<Data> normalData; /*!< vertex normal array (vec3fa) */
+    Ref<Data> vertexListData; /*!< list of per time step vertex arrays */
+    Ref<Data> normalListData; /*!< list of per time step normal arrays */
     Ref<Data> colorData;  /*!< vertex color array (vec3fa) */
     Ref<Data> texcoordData; /*!< vertex texcoord array (vec2f) */
-    Ref<Data> prim_materialIDData;  /*!< data array for per-prim material ID (uint32) */
+    Ref<Data> attributeData; /*!< interleaved vertex attributes (float) */
+    Ref<Data> prim_materialIDData;  /*!< data array for per-prim material ID (uint32 or uint16) */
     Ref<Data> materialListData; /*!< data array for per-prim materials */
+    std::vector<float> keyFrames; /*!< key frames after the first rebuilt from vertex.delta */
+    Ref<Data> keyFramesBaseData; /*!< base key frame 'keyFrames' were rebuilt on */
+    Ref<Data> keyFramesDeltaData; /*!< deltas 'keyFrames' were rebuilt from */
+    Ref<Data> keyFramesMaskData; /*!< delta mask 'keyFrames' were rebuilt with */
+    std::vector<float> shutterKeyFrames; /*!< key frames interpolated at the shutter window's ends */
+    std::vector<box3f> timeStepBounds; /*!< bounds of each time step */
     uint32    eMesh;   /*!< embree triangle mesh handle */
 
+    RTCScene  dynamicScene; /*!< private scene of a dynamic mesh */
+    uint32    dynamicMesh;  /*!< mesh in the private scene */
+    Ref<Data> dynamicIndexData; /*!< topology the private scene was built for */
+    size_t    dynamicNumVerts;
+    int       dynamicNumTimeSteps;
+    size_t    dynamicVertexStride;
+
     void** ispcMaterialPtrs; /*!< pointers to ISPC equivalent materials */
   };
 
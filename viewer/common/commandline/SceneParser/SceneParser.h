@@ -20,8 +20,11 @@
 #include "../CommandLineParser.h"
 #include "ospray/ospray_cpp/Model.h"
 #include "ospcommon/box.h"
+#include "../../util/SceneStreamer.h"
 
 #include <deque>
+#include <functional>
+#include <memory>
 
 namespace commandline {
 
@@ -31,6 +34,17 @@ namespace commandline {
     virtual ~SceneParser() = default;
     virtual std::deque<ospray::cpp::Model> model() const = 0;
     virtual std::deque<ospcommon::box3f>   bbox()  const = 0;
+
+    //! loads the rest of the scene after the models were committed, if any
+    virtual std::shared_ptr<ospray::SceneStreamer> streamer() const
+    { return nullptr; }
+
+    //! rebuilds the moving meshes for just a window of their animation,
+    //! which ray time [0,1] then spans; to be called on the render thread.
+    //! empty if the scene has no such meshes, or motion the window does
+    //! not apply to
+    virtual std::function<void(const ospcommon::vec2f &)> shutterWindow() const
+    { return nullptr; }
   };
 
 } // ::commandline
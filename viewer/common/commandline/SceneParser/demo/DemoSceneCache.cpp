@@ -0,0 +1,448 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file DemoSceneCache.cpp
+
+  The scene cache holds a parsed demo scene in a single file next to the
+  xml: the object graph with its transforms, the material parameters, the
+  decoded texels and the mesh arrays, with the key frames of each animated
+  array stored back to back. Loading it maps the file and points the meshes
+  straight into the mapping, no xml is parsed and no texture is decoded.
+
+  All bulk arrays are 16 byte aligned; the description of the scene follows
+  them at the end of the file, at the offset given in the header.
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+#include "ospcommon/FileName.h"
+#include "../../../miniSG/miniSG.h"
+#include "DemoSceneParser.h"
+
+namespace commandline {
+
+  using namespace ospray;
+  using namespace ospcommon;
+
+  //! bumped on any change to the layout or content of the cache file
+  static const uint32_t cacheVersion = 4;
+  static const char cacheMagic[8] = "OSPDEMO";
+
+  struct CacheHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t sizeofAffine; //!< guards against a different affine3f layout
+    //! the cached texels are of the mip level loaded for this size
+    int32_t textureMaxSize;
+    uint32_t textureHDRFormat;
+    //! size and modification time of the xml and bin files cached
+    uint64_t xmlSize;
+    int64_t xmlTime;
+    uint64_t binSize;
+    int64_t binTime;
+    uint64_t metaOfs;
+    uint64_t metaSize;
+  };
+
+  static void sourceStamp(const std::string& fileName, uint64_t& size, int64_t& time)
+  {
+    struct stat st;
+    if (stat(fileName.c_str(), &st) != 0) {
+      size = 0;
+      time = -1;
+      return;
+    }
+    size = st.st_size;
+    time = st.st_mtime;
+  }
+
+  //! appends bulk arrays to the file, collects the description in memory
+  class CacheWriter
+  {
+  public:
+    CacheWriter(FILE* file) : file(file), pos(sizeof(CacheHeader)) {}
+
+    //! writes an array to the file, returns its offset
+    uint64_t array(const void* ptr, size_t numBytes)
+    {
+      static const char zeros[16] = {};
+      const size_t padding = (16 - pos % 16) % 16;
+      fwrite(zeros, 1, padding, file);
+      pos += padding;
+
+      const uint64_t ofs = pos;
+      if (numBytes)
+        fwrite(ptr, 1, numBytes, file);
+      pos += numBytes;
+      return ofs;
+    }
+
+    //! continues the previous array without padding
+    void append(const void* ptr, size_t numBytes)
+    {
+      if (numBytes)
+        fwrite(ptr, 1, numBytes, file);
+      pos += numBytes;
+    }
+
+    template <typename T>
+    void put(const T& v)
+    {
+      const char* p = (const char*)&v;
+      meta.insert(meta.end(), p, p + sizeof(T));
+    }
+
+    void put(const std::string& str)
+    {
+      put(uint64_t(str.size()));
+      meta.insert(meta.end(), str.begin(), str.end());
+    }
+
+    FILE* file;
+    size_t pos;
+    std::vector<char> meta;
+  };
+
+  //! reads the description of the mapped cache, checking every access
+  class CacheReader
+  {
+  public:
+    CacheReader(const char* base, size_t size, size_t metaOfs, size_t metaSize)
+      : base(base), size(size), cur(base + metaOfs), end(base + metaOfs + metaSize)
+    {
+      if (metaOfs > size || metaSize > size - metaOfs)
+        throw std::runtime_error("invalid scene cache");
+    }
+
+    template <typename T>
+    T get()
+    {
+      T v;
+      if (size_t(end - cur) < sizeof(T))
+        throw std::runtime_error("invalid scene cache");
+      memcpy(&v, cur, sizeof(T));
+      cur += sizeof(T);
+      return v;
+    }
+
+    std::string getString()
+    {
+      const uint64_t n = get<uint64_t>();
+      if (size_t(end - cur) < n)
+        throw std::runtime_error("invalid scene cache");
+      std::string str(cur, n);
+      cur += n;
+      return str;
+    }
+
+    //! pointer to an array of the given size in the mapping
+    const char* array(uint64_t ofs, uint64_t numBytes)
+    {
+      if (ofs > size || numBytes > size - ofs)
+        throw std::runtime_error("invalid scene cache");
+      return base + ofs;
+    }
+
+    const char* base;
+    size_t size;
+    const char* cur;
+    const char* end;
+  };
+
+  //! writes the key frames of an array back to back, returns their offset
+  static uint64_t writeSteps(CacheWriter& out, const vec3f* array,
+                             const std::vector<const vec3f*>& steps, size_t N)
+  {
+    if (steps.empty())
+      return out.array(array, N * sizeof(vec3f));
+
+    // the loader addresses key frame t at t*N, so only the first one may
+    // be padded to the array alignment
+    const uint64_t ofs = out.array(steps[0], N * sizeof(vec3f));
+    for (size_t t = 1; t < steps.size(); t++)
+      out.append(steps[t], N * sizeof(vec3f));
+    return ofs;
+  }
+
+  void DemoSceneParser::writeCache(const FileName& fileName, const FileName& xmlFileName)
+  {
+    // written under a temporary name, such that an interrupted write never
+    // leaves a truncated cache behind
+    const std::string tmpFileName = fileName.str() + ".tmp";
+    FILE* file = fopen(tmpFileName.c_str(), "wb");
+    if (!file) {
+      std::cout << "Failed to write scene cache '" << fileName.str() << "'" << std::endl;
+      return;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(header.magic));
+    header.version = cacheVersion;
+    header.sizeofAffine = sizeof(affine3f);
+    header.textureMaxSize = textureMaxSize;
+    header.textureHDRFormat = textureHDRFormat;
+    sourceStamp(xmlFileName.str(), header.xmlSize, header.xmlTime);
+    sourceStamp(findBinFile(xmlFileName), header.binSize, header.binTime);
+    fwrite(&header, sizeof(header), 1, file);
+
+    CacheWriter out(file);
+
+    // textures that failed to load are left out, their parameters get -1
+    std::vector<int> textureRemap;
+    int numLoaded = 0;
+    for (const TextureInfo& info : textures)
+      textureRemap.push_back(info.texture.get() ? numLoaded++ : -1);
+
+    out.put(uint64_t(numLoaded));
+    for (const TextureInfo& info : textures)
+    {
+      miniSG::Texture2D* texture = info.texture.get();
+      if (!texture)
+        continue;
+      // texels the texture cache freed already are decoded again
+      if (!texture->data)
+        texture = miniSG::loadTexture(info.path, info.fileName);
+
+      out.put(int32_t(texture->width));
+      out.put(int32_t(texture->height));
+      out.put(int32_t(texture->channels));
+      out.put(int32_t(texture->depth));
+      out.put(int32_t(texture->prefereLinear));
+      const size_t numBytes = size_t(texture->width) * texture->height
+                              * texture->channels * texture->depth;
+      out.put(out.array(texture->data, numBytes));
+    }
+
+    std::map<OSPMaterial, int> materialIndex;
+    out.put(uint64_t(materialInfos.size()));
+    for (size_t i = 0; i < materialInfos.size(); i++)
+    {
+      const MaterialInfo& info = materialInfos[i];
+      materialIndex[info.material.handle()] = int(i);
+      out.put(info.id);
+      out.put(info.type);
+      out.put(uint64_t(info.params.size()));
+      for (const auto& p : info.params)
+      {
+        out.put(p.name);
+        out.put(int32_t(p.type));
+        out.put(p.value);
+        out.put(int32_t(p.texture < 0 ? -1 : textureRemap[p.texture]));
+      }
+    }
+
+    std::map<const TriangleMesh*, uint64_t> meshIndex;
+    std::vector<const TriangleMesh*> meshes;
+    for (const auto& object : scene->objects)
+      for (const auto& mesh : object->meshes)
+        if (meshIndex.emplace(mesh.get(), meshes.size()).second)
+          meshes.push_back(mesh.get());
+
+    out.put(uint64_t(meshes.size()));
+    for (const TriangleMesh* mesh : meshes)
+    {
+      // meshes with the default (or an unknown) material get -1
+      auto material = materialIndex.find(mesh->material.handle());
+      out.put(int32_t(material != materialIndex.end() ? material->second : -1));
+      out.put(uint64_t(mesh->numTriangles));
+      out.put(uint64_t(mesh->numPositions));
+      out.put(uint64_t(mesh->numNormals));
+      out.put(uint64_t(mesh->numTexcoords));
+      out.put(uint64_t(mesh->animatedPositions.size()));
+      out.put(uint64_t(mesh->animatedNormals.size()));
+      out.put(out.array(mesh->triangles, mesh->numTriangles * sizeof(vec3i)));
+      out.put(writeSteps(out, mesh->positions, mesh->animatedPositions, mesh->numPositions));
+      out.put(writeSteps(out, mesh->normals, mesh->animatedNormals, mesh->numNormals));
+      out.put(out.array(mesh->texcoords, mesh->numTexcoords * sizeof(vec2f)));
+    }
+
+    out.put(uint64_t(scene->objects.size()));
+    for (const auto& object : scene->objects)
+    {
+      out.put(uint64_t(object->meshes.size()));
+      for (const auto& mesh : object->meshes)
+        out.put(meshIndex[mesh.get()]);
+      out.put(uint64_t(object->transforms.size()));
+      for (const affine3f& transform : object->transforms)
+        out.put(transform);
+      out.put(uint64_t(object->animatedTransforms.size()));
+      for (const auto& transforms : object->animatedTransforms)
+      {
+        out.put(uint64_t(transforms.size()));
+        for (const affine3f& transform : transforms)
+          out.put(transform);
+      }
+    }
+
+    header.metaOfs = out.array(out.meta.data(), out.meta.size());
+    header.metaSize = out.meta.size();
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    const bool failed = ferror(file);
+    fclose(file);
+    if (failed || rename(tmpFileName.c_str(), fileName.str().c_str()) != 0) {
+      remove(tmpFileName.c_str());
+      std::cout << "Failed to write scene cache '" << fileName.str() << "'" << std::endl;
+    }
+  }
+
+  bool DemoSceneParser::importCache(const FileName& fileName, const FileName& xmlFileName)
+  {
+    // a missing, older or stale cache is silently rebuilt from the xml
+    CacheHeader header;
+    FILE* file = fopen(fileName.str().c_str(), "rb");
+    if (!file)
+      return false;
+    const bool complete = fread(&header, sizeof(header), 1, file) == 1;
+    fclose(file);
+
+    uint64_t xmlSize, binSize;
+    int64_t xmlTime, binTime;
+    sourceStamp(xmlFileName.str(), xmlSize, xmlTime);
+    sourceStamp(findBinFile(xmlFileName), binSize, binTime);
+    if (!complete
+        || memcmp(header.magic, cacheMagic, sizeof(header.magic)) != 0
+        || header.version != cacheVersion
+        || header.sizeofAffine != sizeof(affine3f)
+        || header.textureMaxSize != textureMaxSize
+        || header.textureHDRFormat != uint32_t(textureHDRFormat)
+        || header.xmlSize != xmlSize || header.xmlTime != xmlTime
+        || header.binSize != binSize || header.binTime != binTime)
+      return false;
+
+    const char* base = mapFile(fileName.str());
+    CacheReader in(base, meshFactory->binMappings.back().second, header.metaOfs, header.metaSize);
+
+    path = xmlFileName.path();
+    if (path == "")
+      path = ".";
+    scene = std::make_shared<Scene>();
+    createDefaultMaterial();
+
+    const uint64_t numTextures = in.get<uint64_t>();
+    const int firstTexture = int(textures.size());
+    for (uint64_t i = 0; i < numTextures; i++)
+    {
+      // the texels are copied by ospNewTexture2D, the mapping only has to
+      // live until the materials are committed
+      miniSG::Texture2D* texture = new miniSG::Texture2D;
+      texture->width = in.get<int32_t>();
+      texture->height = in.get<int32_t>();
+      texture->channels = in.get<int32_t>();
+      texture->depth = in.get<int32_t>();
+      texture->prefereLinear = in.get<int32_t>() != 0;
+      const size_t numBytes = size_t(texture->width) * texture->height
+                              * texture->channels * texture->depth;
+      texture->data = (void*)in.array(in.get<uint64_t>(), numBytes);
+      std::promise<miniSG::Texture2D*> decoded;
+      decoded.set_value(texture);
+      textures.push_back({path, "", decoded.get_future().share()});
+    }
+
+    const uint64_t numMaterials = in.get<uint64_t>();
+    std::vector<cpp::Material> materials;
+    for (uint64_t i = 0; i < numMaterials; i++)
+    {
+      MaterialInfo info;
+      info.id = in.getString();
+      info.type = in.getString();
+      const uint64_t numParams = in.get<uint64_t>();
+      for (uint64_t j = 0; j < numParams; j++)
+      {
+        MaterialInfo::Param p;
+        p.name = in.getString();
+        p.type = (MaterialInfo::ParamType)in.get<int32_t>();
+        p.value = in.get<vec3f>();
+        p.texture = in.get<int32_t>();
+        if (p.texture >= int(numTextures))
+          throw std::runtime_error("invalid scene cache");
+        if (p.texture >= 0)
+          p.texture += firstTexture;
+        info.params.push_back(p);
+      }
+
+      info.material = cpp::Material(ospNewMaterial(renderer.handle(), info.type.c_str()));
+      if (!info.id.empty())
+        materialMap[info.id] = info.material;
+      materials.push_back(info.material);
+      materialInfos.push_back(info);
+    }
+
+    const uint64_t numMeshes = in.get<uint64_t>();
+    std::vector<std::shared_ptr<TriangleMesh>> meshes;
+    for (uint64_t i = 0; i < numMeshes; i++)
+    {
+      std::shared_ptr<TriangleMesh> mesh = std::make_shared<TriangleMesh>();
+      const int32_t material = in.get<int32_t>();
+      if (material >= int32_t(materials.size()))
+        throw std::runtime_error("invalid scene cache");
+      mesh->material = material < 0 ? cpp::Material(defaultMaterial) : materials[material];
+
+      mesh->numTriangles = in.get<uint64_t>();
+      mesh->numPositions = in.get<uint64_t>();
+      mesh->numNormals = in.get<uint64_t>();
+      mesh->numTexcoords = in.get<uint64_t>();
+      const uint64_t positionSteps = in.get<uint64_t>();
+      const uint64_t normalSteps = in.get<uint64_t>();
+
+      mesh->triangles = (const vec3i*)in.array(in.get<uint64_t>(), mesh->numTriangles * sizeof(vec3i));
+      mesh->positions = (const vec3f*)in.array(in.get<uint64_t>(),
+                          std::max(positionSteps, uint64_t(1)) * mesh->numPositions * sizeof(vec3f));
+      for (uint64_t t = 0; t < positionSteps; t++)
+        mesh->animatedPositions.push_back(mesh->positions + t * mesh->numPositions);
+      mesh->normals = (const vec3f*)in.array(in.get<uint64_t>(),
+                        std::max(normalSteps, uint64_t(1)) * mesh->numNormals * sizeof(vec3f));
+      for (uint64_t t = 0; t < normalSteps; t++)
+        mesh->animatedNormals.push_back(mesh->normals + t * mesh->numNormals);
+      mesh->texcoords = (const vec2f*)in.array(in.get<uint64_t>(), mesh->numTexcoords * sizeof(vec2f));
+      meshes.push_back(mesh);
+    }
+
+    const uint64_t numObjects = in.get<uint64_t>();
+    for (uint64_t i = 0; i < numObjects; i++)
+    {
+      std::shared_ptr<Object> object = std::make_shared<Object>();
+      const uint64_t numObjectMeshes = in.get<uint64_t>();
+      for (uint64_t j = 0; j < numObjectMeshes; j++)
+      {
+        const uint64_t mesh = in.get<uint64_t>();
+        if (mesh >= meshes.size())
+          throw std::runtime_error("invalid scene cache");
+        object->meshes.push_back(meshes[mesh]);
+      }
+      const uint64_t numTransforms = in.get<uint64_t>();
+      for (uint64_t j = 0; j < numTransforms; j++)
+        object->transforms.push_back(in.get<affine3f>());
+      const uint64_t numAnimated = in.get<uint64_t>();
+      for (uint64_t j = 0; j < numAnimated; j++)
+      {
+        std::vector<affine3f> transforms(in.get<uint64_t>());
+        for (affine3f& transform : transforms)
+          transform = in.get<affine3f>();
+        object->animatedTransforms.push_back(transforms);
+      }
+      scene->objects.push_back(object);
+    }
+
+    return true;
+  }
+
+} // ::commandline
@@ -19,10 +19,15 @@
 #define  O_LARGEFILE  0
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <unistd.h>
 #include "ospcommon/FileName.h"
+#include "ospcommon/tasking/parallel_for.h"
 #include "../../../miniSG/miniSG.h"
 #include "DemoSceneParser.h"
 
@@ -31,26 +36,147 @@ namespace commandline {
   using namespace ospray;
   using namespace ospcommon;
 
+  // oct-encode a normal into two snorm16 values (x in the low bits)
+  static inline uint32_t octEncode(const vec3f &n)
+  {
+    const float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    float ex = l1 > 0.f ? n.x / l1 : 0.f;
+    float ey = l1 > 0.f ? n.y / l1 : 0.f;
+    if (n.z < 0.f) {
+      const float fx = (1.f - std::abs(ey)) * (ex >= 0.f ? 1.f : -1.f);
+      const float fy = (1.f - std::abs(ex)) * (ey >= 0.f ? 1.f : -1.f);
+      ex = fx;
+      ey = fy;
+    }
+    const int16_t qx = (int16_t)std::round(std::min(std::max(ex, -1.f), 1.f) * 32767.f);
+    const int16_t qy = (int16_t)std::round(std::min(std::max(ey, -1.f), 1.f) * 32767.f);
+    return uint32_t(uint16_t(qx)) | (uint32_t(uint16_t(qy)) << 16);
+  }
+
+  // arrays larger than this need 64-bit addressing in blur_triangles
+  static const size_t maxArrayBytes = std::numeric_limits<int32_t>::max();
+
+  //! size of the largest array blur_triangles gets for the mesh
+  template <typename MESH>
+  static size_t largestArrayBytes(const MESH& m)
+  {
+    const size_t positionSteps = std::max(m.animatedPositions.size(), size_t(1));
+    const size_t normalSteps = std::max(m.animatedNormals.size(), size_t(1));
+    return std::max({m.numTriangles * sizeof(vec3i),
+                     positionSteps * m.numPositions * sizeof(vec3f),
+                     normalSteps * m.numNormals * sizeof(vec3f),
+                     m.numTexcoords * sizeof(vec2f)});
+  }
+
+  //! bytes of the arrays of the mesh with numSteps time steps
+  template <typename MESH>
+  static size_t meshBytes(const MESH& m, size_t numSteps)
+  {
+    return m.numTriangles * sizeof(vec3i)
+         + numSteps * (m.numPositions + m.numNormals) * sizeof(vec3f)
+         + m.numTexcoords * sizeof(vec2f);
+  }
+
+  // prepared meshes are created and freed after at most this many bytes
+  static const size_t maxBatchBytes = size_t(256) << 20;
+
+  template <typename T>
+  static void gatherVertices(const T* src, const std::vector<int>& used, std::vector<T>& dst)
+  {
+    dst.resize(used.size());
+    for (size_t i = 0; i < used.size(); i++)
+      dst[i] = src[used[i]];
+  }
+
+  const vec3f* DemoSceneParser::TriangleMesh::transformArray(
+    const vec3f* in, size_t N, const affine3f& space, bool normals
+  )
+  {
+    if (N == 0)
+      return nullptr;
+
+    transformedArrays.emplace_back(N);
+    vec3f* out = transformedArrays.back().data();
+
+    // normals transform with the inverse transpose, computed once instead
+    // of per normal; the straight per-block loops vectorize
+    const linear3f l = normals ? transposed(rcp(space.l)) : space.l;
+    const vec3f p = normals ? vec3f(0.f) : space.p;
+    const size_t blockSize = 64*1024;
+    const size_t numBlocks = (N + blockSize - 1) / blockSize;
+    tasking::parallel_for(int(numBlocks), [&](int block) {
+      const size_t begin = block * blockSize;
+      const size_t end = std::min(begin + blockSize, N);
+      for (size_t i = begin; i < end; i++)
+        out[i] = l.vx * in[i].x + l.vy * in[i].y + l.vz * in[i].z + p;
+    });
+    return out;
+  }
+
   DemoSceneParser::DemoSceneParser(cpp::Renderer renderer)
-    : renderer(renderer)
+    : renderer(renderer),
+      textureHDRFormat(miniSG::TEXTURE_HDR_RGBE),
+      meshFactory(std::make_shared<MeshFactory>())
   {
   }
 
   bool DemoSceneParser::parse(int ac, const char **&av)
   {
+    std::vector<FileName> fileNames;
     for (int i = 1; i < ac; i++)
     {
       const std::string arg = av[i];
       if (arg == "--flatten")
         flatten = true;
+      else if (arg == "--oct-normals")
+        meshFactory->octNormals = true;
+      else if (arg == "--delta-timesteps")
+        meshFactory->deltaTimeSteps = true;
+      else if (arg == "--timestep-tolerance")
+        meshFactory->timeStepTolerance = atof(av[++i]);
+      else if (arg == "--cache")
+        useCache = true;
+      else if (arg == "--stream")
+        stream = true;
+      else if (arg == "--texture-cache-mb")
+        miniSG::setTextureCacheBudget(size_t(atol(av[++i])) << 20);
+      else if (arg == "--texture-max-size")
+        textureMaxSize = atoi(av[++i]);
+      else if (arg == "--texture-hdr-format")
+      {
+        const std::string format = av[++i];
+        if (format == "float")
+          textureHDRFormat = miniSG::TEXTURE_HDR_FLOAT;
+        else if (format == "half")
+          textureHDRFormat = miniSG::TEXTURE_HDR_HALF;
+        else if (format == "rgbe")
+          textureHDRFormat = miniSG::TEXTURE_HDR_RGBE;
+        else
+          throw std::runtime_error("unknown texture HDR format: " + format);
+      }
       else
       {
         FileName fn = arg;
         if (fn.ext() == "xml")
-          importXml(fn);
+          fileNames.push_back(fn);
       }
     }
 
+    miniSG::setTexturePreprocessing(textureMaxSize, textureHDRFormat);
+
+    // the scene is loaded from the cache next to the xml file while it is up
+    // to date, otherwise the cache is rewritten after parsing the xml
+    for (const FileName& fn : fileNames)
+    {
+      const FileName cacheFileName = fn.str() + ".cache";
+      if (useCache && importCache(cacheFileName, fn))
+        continue;
+
+      importXml(fn);
+      if (useCache)
+        writeCache(cacheFileName, fn);
+    }
+
     finalize();
     sceneModel.commit();
     sceneModels.push_back(sceneModel);
@@ -58,6 +184,36 @@ namespace commandline {
     return true;
   }
 
+  std::string DemoSceneParser::findBinFile(const FileName& fileName) const
+  {
+    std::string binFileName = fileName.str() + ".bin";
+    if (access(binFileName.c_str(), R_OK) != 0)
+      binFileName = fileName.str().substr(0, fileName.str().find_last_of('.')) + ".bin";
+    return binFileName;
+  }
+
+  const char* DemoSceneParser::mapFile(const std::string& fileName)
+  {
+    FILE *file = fopen(fileName.c_str(), "rb");
+    if (!file)
+      throw std::runtime_error("could not open binary file: " + fileName);
+    fseek(file, 0, SEEK_END);
+    ssize_t fileSize = ftell(file);
+    fclose(file);
+
+    int fd = ::open(fileName.c_str(), O_LARGEFILE | O_RDONLY);
+    if (fd == -1) {
+      throw std::runtime_error("could not open file: " + fileName);
+    }
+
+    const char* ptr = (const char*)mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+      throw std::runtime_error("could not map file: " + fileName);
+    meshFactory->binMappings.emplace_back(ptr, fileSize);
+    return ptr;
+  }
+
   void DemoSceneParser::importXml(const FileName& fileName)
   {
     std::shared_ptr<xml::XMLDoc> doc = xml::readXML(fileName);
@@ -69,34 +225,14 @@ namespace commandline {
     if (path == "")
       path = ".";
 
-    std::string binFileName = fileName.str() + ".bin";
-
-    FILE *file = fopen(binFileName.c_str(), "rb");
-    if (!file) {
-      binFileName = fileName.str().substr(0, fileName.str().find_last_of('.')) + ".bin";
-      file = fopen(binFileName.c_str(), "rb");
-      if (!file)
-        throw std::runtime_error("could not open binary file: " + binFileName);
-    }
-    fseek(file, 0, SEEK_END);
-    ssize_t fileSize = ftell(file);
-    fclose(file);
-
-    int fd = ::open(binFileName.c_str(), O_LARGEFILE | O_RDONLY);
-    if (fd == -1) {
-      throw std::runtime_error("could not open file: " + binFileName);
-    }
-
-    binBasePtr = (char*)mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+    binBasePtr = (char*)mapFile(findBinFile(fileName));
 
     const xml::Node& root = *doc->child[0];
     parseScene(root);
   }
 
-  void DemoSceneParser::parseScene(const xml::Node& node)
+  void DemoSceneParser::createDefaultMaterial()
   {
-    scene = std::make_shared<Scene>();
-
     defaultMaterial = ospNewMaterial(renderer.handle(), "OBJMaterial");
     vec3f kd(.7f);
     vec3f ks(.3f);
@@ -104,6 +240,13 @@ namespace commandline {
     ospSet3fv(defaultMaterial, "Ks", &ks.x);
     ospSet1f(defaultMaterial, "Ns", 99.f);
     ospCommit(defaultMaterial);
+  }
+
+  void DemoSceneParser::parseScene(const xml::Node& node)
+  {
+    scene = std::make_shared<Scene>();
+
+    createDefaultMaterial();
 
     for (size_t i = 0; i < node.child.size(); i++)
     {
@@ -318,11 +461,11 @@ namespace commandline {
     char typeC[1024];
     sscanf(type.c_str(), "\"%[^\"]\"", typeC);
 
-    std::string ospType = typeC;
-    if (ospType == "OBJ")
-      ospType = "OBJMaterial";
-
-    cpp::Material mtl(ospNewMaterial(renderer.handle(), ospType.c_str()));
+    MaterialInfo info;
+    info.id = node.getProp("id");
+    info.type = typeC;
+    if (info.type == "OBJ")
+      info.type = "OBJMaterial";
 
     for (size_t i = 0; i < node.child.size(); i++)
     {
@@ -331,44 +474,86 @@ namespace commandline {
       {
         for (const auto& param : child.child)
         {
-          std::string name = param->getProp("name");
+          MaterialInfo::Param p;
+          p.name = param->getProp("name");
+          p.value = vec3f(0.f);
+          p.texture = -1;
 
           if (param->name == "float")
           {
-            float v;
-            int numRead = sscanf((char*)param->content.c_str(), "%f", &v);
+            p.type = MaterialInfo::FLOAT;
+            int numRead = sscanf((char*)param->content.c_str(), "%f", &p.value.x);
             if (numRead != 1)
               throw std::runtime_error("invalid float");
-            mtl.set(name, v);
           }
           else if (param->name == "float3")
           {
-            vec3f v;
-            int numRead = sscanf((char*)param->content.c_str(), "%f %f %f", &v.x, &v.y, &v.z);
+            p.type = MaterialInfo::FLOAT3;
+            int numRead = sscanf((char*)param->content.c_str(), "%f %f %f", &p.value.x, &p.value.y, &p.value.z);
             if (numRead != 3)
               throw std::runtime_error("invalid float3");
-            mtl.set(name, v);
           }
-          else if (param->name == "texture2d")
+          else if (param->name == "texture2d" || param->name == "texture3d")
           {
-            auto texture = miniSG::loadTexture(path, param->content);
-            OSPTexture2D ospTexture = miniSG::createTexture2D(texture);
-            mtl.set(name, ospTexture);
-          }
-          else if (param->name == "texture3d")
-          {
-            // Also a 2D texture, why is it called 3D??
-            std::string fileName = param->getProp("src");
-            auto texture = miniSG::loadTexture(path, fileName);
-            OSPTexture2D ospTexture = miniSG::createTexture2D(texture);
-            mtl.set(name, ospTexture);
+            // texture3d is also a 2D texture, why is it called 3D??
+            const std::string fileName = param->name == "texture2d" ? param->content
+                                                                    : param->getProp("src");
+            p.type = MaterialInfo::TEXTURE;
+            // decoded on the texture workers while parsing goes on, the
+            // material waits for it when it is committed. relative file
+            // names of different xml files may name different textures
+            const std::string key = path + "/" + fileName;
+            auto it = textureIndex.find(key);
+            if (it == textureIndex.end())
+            {
+              it = textureIndex.emplace(key, int(textures.size())).first;
+              textures.push_back({path, fileName, miniSG::loadTextureAsync(path, fileName)});
+            }
+            p.texture = it->second;
           }
+          else
+            continue;
+
+          info.params.push_back(p);
         }
       }
     }
 
+    info.material = cpp::Material(ospNewMaterial(renderer.handle(), info.type.c_str()));
+    materialInfos.push_back(info);
+    return info.material;
+  }
+
+  void DemoSceneParser::commitMaterial(MaterialInfo& info)
+  {
+    cpp::Material& mtl = info.material;
+
+    for (const auto& p : info.params)
+    {
+      switch (p.type) {
+      case MaterialInfo::FLOAT:
+        mtl.set(p.name, p.value.x);
+        break;
+      case MaterialInfo::FLOAT3:
+        mtl.set(p.name, p.value);
+        break;
+      case MaterialInfo::TEXTURE:
+        OSPTexture2D ospTexture = miniSG::createTexture2D(p.texture < 0 ? nullptr : textures[p.texture].texture.get());
+        mtl.set(p.name, ospTexture);
+        break;
+      }
+    }
+
     mtl.commit();
-    return mtl;
+    info.committed = true;
+  }
+
+  void DemoSceneParser::commitMaterials()
+  {
+    // each material only waits for the decoding of its own textures
+    for (auto& info : materialInfos)
+      if (!info.committed)
+        commitMaterial(info);
   }
 
   void DemoSceneParser::parseAssign(const ospray::xml::Node& node)
@@ -392,166 +577,494 @@ namespace commandline {
   {
     sceneBounds = empty;
 
-    for (const auto& object : scene->objects)
+    std::vector<box3f> objectBounds(scene->objects.size(), box3f(empty));
+    tasking::parallel_for(int(scene->objects.size()), [&](int i) {
+      for (const auto& mesh : scene->objects[i]->meshes)
+        objectBounds[i].extend(computeTriangleMeshBounds(mesh));
+    });
+
+    // the textures were decoding in the meantime
+    commitMaterials();
+
+    for (const char* id : {"train_pusher", "train_wheel"})
+      if (materialMap.find(id) != materialMap.end())
+        meshFactory->trainMaterials.push_back(materialMap[id].handle());
+
+    if (stream)
     {
-      box3f objectBounds = empty;
-      for (const auto& mesh : object->meshes)
-        objectBounds.extend(computeTriangleMeshBounds(mesh));
+      finalizeStreaming(objectBounds);
+      return;
+    }
+
+    // collect the meshes to create, with the model each one goes into
+    struct PendingMesh
+    {
+      std::shared_ptr<TriangleMesh> mesh;
+      const affine3f* space;
+      const std::vector<affine3f>* spaces;
+      cpp::Model* model;
+      std::vector<std::shared_ptr<TriangleMesh>> prepared;
+    };
+    std::vector<PendingMesh> pending;
+    std::deque<cpp::Model> objectModels;
 
+    for (size_t i = 0; i < scene->objects.size(); i++)
+    {
+      const auto& object = scene->objects[i];
       if (flatten || object->transforms.size() == 0)
       {
         for (const auto& mesh : object->meshes)
         {
           if (object->animatedTransforms.size())
           {
-            for (const auto& spaces : object->animatedTransforms) {
-              auto tmesh = std::make_shared<TriangleMesh>(mesh,spaces);
-              cpp::Geometry ospGeometry = createOspTriangleMesh(tmesh);
-              sceneModel.addGeometry(ospGeometry);
-            }
+            for (const auto& spaces : object->animatedTransforms)
+              pending.push_back({mesh, nullptr, &spaces, &sceneModel, {}});
           }
           else if (object->transforms.size())
           {
-            for (const auto& space : object->transforms) {
-              auto tmesh = std::make_shared<TriangleMesh>(mesh,space);
-              cpp::Geometry ospGeometry = createOspTriangleMesh(tmesh);
-              sceneModel.addGeometry(ospGeometry);
-            }
+            for (const auto& space : object->transforms)
+              pending.push_back({mesh, &space, nullptr, &sceneModel, {}});
           }
           else
           {
-            cpp::Geometry ospGeometry = createOspTriangleMesh(mesh);
-            sceneModel.addGeometry(ospGeometry);
+            pending.push_back({mesh, nullptr, nullptr, &sceneModel, {}});
           }
         }
 
-        sceneBounds.extend(objectBounds);
+        sceneBounds.extend(objectBounds[i]);
       }
       else
       {
         // Instancing
-        cpp::Model ospModel;
+        objectModels.emplace_back();
         for (const auto& mesh : object->meshes)
+          pending.push_back({mesh, nullptr, nullptr, &objectModels.back(), {}});
+      }
+    }
+
+    // transformed copies and chunks of the meshes are prepared in parallel,
+    // the ospray objects are created and committed on this thread; their
+    // BVHs get built together at the commit of the model holding them.
+    // batches of prepared meshes are created and freed before the next one
+    // is prepared, such that flattening does not hold the whole transformed
+    // scene in memory next to ospray's copies of it
+    for (size_t begin = 0; begin < pending.size();)
+    {
+      size_t end = begin;
+      size_t batchBytes = 0;
+      while (end < pending.size() && (end == begin || batchBytes < maxBatchBytes))
+      {
+        const PendingMesh& p = pending[end++];
+        const size_t numSteps = p.spaces ? p.spaces->size()
+                              : std::max(p.mesh->animatedPositions.size(), size_t(1));
+        if (p.space || p.spaces || largestArrayBytes(*p.mesh) > maxArrayBytes)
+          batchBytes += meshBytes(*p.mesh, numSteps);
+      }
+
+      tasking::parallel_for(int(end - begin), [&](int i) {
+        PendingMesh& p = pending[begin + i];
+        std::shared_ptr<TriangleMesh> mesh = p.mesh;
+        if (p.spaces)
+          mesh = std::make_shared<TriangleMesh>(p.mesh, *p.spaces);
+        else if (p.space)
+          mesh = std::make_shared<TriangleMesh>(p.mesh, *p.space);
+        p.prepared = meshFactory->splitTriangleMesh(mesh);
+      });
+
+      for (size_t i = begin; i < end; i++)
+      {
+        PendingMesh& p = pending[i];
+        for (auto& mesh : p.prepared)
         {
-          cpp::Geometry ospGeometry = createOspTriangleMesh(mesh);
-          ospModel.addGeometry(ospGeometry);
+          meshFactory->addOspTriangleMesh(*p.model, mesh);
+          // ospray copied the transformed arrays, free them right away
+          mesh.reset();
         }
-        ospModel.commit();
+        p.prepared.clear();
+      }
+      begin = end;
+    }
+
+    auto ospModel = objectModels.begin();
+    for (size_t i = 0; i < scene->objects.size(); i++)
+    {
+      const auto& object = scene->objects[i];
+      if (flatten || object->transforms.size() == 0)
+        continue;
+
+      ospModel->commit();
 
-        if (object->animatedTransforms.size() == 0)
+      if (object->animatedTransforms.size() == 0)
+      {
+        for (const affine3f& transform : object->transforms)
         {
-          for (const affine3f& transform : object->transforms)
-          {
-            cpp::Geometry ospInstance = ospNewInstance(ospModel.handle(), (osp::affine3f&)transform);
-            sceneModel.addGeometry(ospInstance);
-            sceneBounds.extend(computeInstanceBounds(objectBounds, transform));
-          }
+          cpp::Geometry ospInstance = ospNewInstance(ospModel->handle(), (osp::affine3f&)transform);
+          sceneModel.addGeometry(ospInstance);
+          sceneBounds.extend(computeInstanceBounds(objectBounds[i], transform));
         }
-        else
+      }
+      else
+      {
+        // the shared model is instanced with all of its key frames, the
+        // meshes are only copied per key frame when flattening
+        for (const std::vector<affine3f>& animatedTransforms : object->animatedTransforms)
         {
-    #if 0
-          for (const std::vector<affine3f>& animatedTransforms : object->animatedTransforms)
-          {
-            cpp::Geometry ospInstance = ospNewInstance2(ospModel.handle(), (osp::affine3f*)animatedTransforms.data(), animatedTransforms.size());
-            sceneModel.addGeometry(ospInstance);
-            for (const affine3f& transform : animatedTransforms)
-              sceneBounds.extend(computeInstanceBounds(objectBounds, transform));
-          }
-    #endif
+          cpp::Geometry ospInstance("blur_instance");
+          ospInstance.set("model", ospModel->handle());
+          OSPData ospXfm = ospNewData(animatedTransforms.size() * 4, OSP_FLOAT3, animatedTransforms.data());
+          ospInstance.set("xfm", ospXfm);
+          ospInstance.commit();
+          sceneModel.addGeometry(ospInstance);
+          for (const affine3f& transform : animatedTransforms)
+            sceneBounds.extend(computeInstanceBounds(objectBounds[i], transform));
+        }
+      }
+
+      ++ospModel;
+    }
+  }
+
+  bool DemoSceneParser::MeshFactory::isSharable(const void* ptr, size_t numBytes) const
+  {
+    // embree and the ISPC gathers may load up to 16 bytes past the last
+    // element, which must not run past the end of the mapping
+    const char* p = (const char*)ptr;
+    for (const auto& m : binMappings)
+      if (p >= m.first && p + numBytes + 16 <= m.first + m.second)
+        return true;
+    return false;
+  }
+
+  OSPData DemoSceneParser::MeshFactory::newData(size_t numItems, OSPDataType type,
+                                                const void* ptr, size_t itemSize) const
+  {
+    // data in the mapped file lives as long as the application, use it in
+    // place instead of copying it
+    const uint32_t flags = isSharable(ptr, numItems * itemSize) ? OSP_DATA_SHARED_BUFFER : 0;
+    return ospNewData(numItems, type, ptr, flags);
+  }
+
+  bool DemoSceneParser::MeshFactory::stridedTimeSteps(const std::vector<const vec3f*>& steps,
+                                                      size_t numPerStep,
+                                                      size_t& stride,
+                                                      size_t& numItems) const
+  {
+    // time steps at a constant distance in the mapped file can be shared
+    // as a single buffer, with the distance as the time step stride
+    const char* first = (const char*)steps[0];
+    stride = steps.size() > 1 ? (const char*)steps[1] - first : 0;
+    if (steps.size() > 1 && (stride < numPerStep * sizeof(vec3f) || stride % sizeof(float)
+                             || stride > size_t(std::numeric_limits<int32_t>::max())))
+      return false;
+    for (size_t t = 1; t < steps.size(); t++)
+      if ((const char*)steps[t] != first + t * stride)
+        return false;
+
+    const size_t numBytes = (steps.size() - 1) * stride + numPerStep * sizeof(vec3f);
+    numItems = (numBytes + sizeof(vec3f) - 1) / sizeof(vec3f);
+    return isSharable(first, numItems * sizeof(vec3f));
+  }
+
+  std::shared_ptr<DemoSceneParser::MeshChunk> DemoSceneParser::MeshFactory::extractMeshChunk(
+    const std::shared_ptr<TriangleMesh>& mesh, size_t begin, size_t end
+  ) const
+  {
+    auto chunk = std::make_shared<MeshChunk>();
+
+    // compact the vertices used by the chunk's triangles
+    std::vector<int> remap(mesh->numPositions, -1);
+    std::vector<int> used;
+    chunk->chunkTriangles.reserve(end - begin);
+    for (size_t i = begin; i < end; i++)
+    {
+      vec3i tri = mesh->triangles[i];
+      for (int k = 0; k < 3; k++)
+      {
+        int& v = tri[k];
+        if (remap[v] < 0)
+        {
+          remap[v] = used.size();
+          used.push_back(v);
         }
+        v = remap[v];
       }
+      chunk->chunkTriangles.push_back(tri);
+    }
+
+    gatherVertices(mesh->positions, used, chunk->chunkPositions);
+    chunk->chunkAnimatedPositions.resize(mesh->animatedPositions.size());
+    for (size_t t = 0; t < mesh->animatedPositions.size(); t++)
+      gatherVertices(mesh->animatedPositions[t], used, chunk->chunkAnimatedPositions[t]);
+
+    if (mesh->numNormals > 0)
+    {
+      gatherVertices(mesh->normals, used, chunk->chunkNormals);
+      chunk->chunkAnimatedNormals.resize(mesh->animatedNormals.size());
+      for (size_t t = 0; t < mesh->animatedNormals.size(); t++)
+        gatherVertices(mesh->animatedNormals[t], used, chunk->chunkAnimatedNormals[t]);
     }
+
+    if (mesh->numTexcoords > 0)
+      gatherVertices(mesh->texcoords, used, chunk->chunkTexcoords);
+
+    chunk->triangles = chunk->chunkTriangles.data();
+    chunk->numTriangles = chunk->chunkTriangles.size();
+    chunk->positions = chunk->chunkPositions.data();
+    chunk->numPositions = chunk->chunkPositions.size();
+    chunk->normals = chunk->chunkNormals.data();
+    chunk->numNormals = chunk->chunkNormals.size();
+    chunk->texcoords = chunk->chunkTexcoords.data();
+    chunk->numTexcoords = chunk->chunkTexcoords.size();
+    for (const auto& p : chunk->chunkAnimatedPositions)
+      chunk->animatedPositions.push_back(p.data());
+    for (const auto& n : chunk->chunkAnimatedNormals)
+      chunk->animatedNormals.push_back(n.data());
+    chunk->material = mesh->material;
+    return chunk;
   }
 
-  cpp::Geometry DemoSceneParser::createOspTriangleMesh(
+  std::vector<std::shared_ptr<DemoSceneParser::TriangleMesh>>
+  DemoSceneParser::MeshFactory::splitTriangleMesh(const std::shared_ptr<TriangleMesh>& mesh) const
+  {
+    const size_t bytes = largestArrayBytes(*mesh);
+    if (bytes <= maxArrayBytes)
+      return {mesh};
+
+    // split meshes too large for 32-bit addressing into triangle ranges that
+    // fit, such that blur_triangles never falls back to 64-bit gathers.
+    // start from an even split, halve the ranges that still do not fit
+    const size_t numChunks = bytes / maxArrayBytes + 1;
+    std::vector<std::shared_ptr<TriangleMesh>> chunks;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t i = numChunks; i > 0; i--)
+      ranges.emplace_back((i-1) * mesh->numTriangles / numChunks,
+                          i * mesh->numTriangles / numChunks);
+    while (!ranges.empty())
+    {
+      const auto range = ranges.back();
+      ranges.pop_back();
+
+      auto chunk = extractMeshChunk(mesh, range.first, range.second);
+      if (largestArrayBytes(*chunk) > maxArrayBytes && range.second - range.first > 1)
+      {
+        const size_t mid = (range.first + range.second) / 2;
+        ranges.emplace_back(mid, range.second);
+        ranges.emplace_back(range.first, mid);
+        continue;
+      }
+
+      chunks.push_back(chunk);
+    }
+    return chunks;
+  }
+
+  cpp::Geometry DemoSceneParser::MeshFactory::createOspTriangleMesh(
     const std::shared_ptr<TriangleMesh>& mesh
-  )
+  ) const
   {
     bool istrain = true;
-    ospray::cpp::Material pusher_material = nullptr;
-    if (materialMap.find("train_pusher") != materialMap.end())
-      pusher_material = materialMap["train_pusher"];
-    istrain &= mesh->material.object() != pusher_material.object();
-
-    ospray::cpp::Material wheel_material = nullptr;
-    if (materialMap.find("train_wheel") != materialMap.end())
-      wheel_material = materialMap["train_wheel"];
-    istrain &= mesh->material.object() != wheel_material.object();
+    for (OSPMaterial material : trainMaterials)
+      istrain &= mesh->material.handle() != material;
 
     cpp::Geometry ospGeometry("blur_triangles");
+    size_t stride = 0, numItems = 0;
 
-    OSPData ospIndex = ospNewData(mesh->numTriangles, OSP_INT3, mesh->triangles);
+    OSPData ospIndex = newData(mesh->numTriangles, OSP_INT3, mesh->triangles, sizeof(vec3i));
     ospGeometry.set("index", ospIndex);
 
     if (mesh->animatedPositions.size() == 0)
     {
-      OSPData ospPosition = ospNewData(mesh->numPositions, OSP_FLOAT3, mesh->positions);
+      OSPData ospPosition = newData(mesh->numPositions, OSP_FLOAT3, mesh->positions, sizeof(vec3f));
       ospGeometry.set("position", ospPosition);
     }
-    /* forces the train to two time steps only */
-    else if (istrain)
+    else if (deltaTimeSteps)
     {
-      size_t t0 = 0, t1 = mesh->animatedPositions.size()-1;
-      std::vector<vec3f> buffer(2 * mesh->numPositions);
-      for (size_t i = 0; i < mesh->numPositions; i++)
-        buffer[0*mesh->numPositions + i] = mesh->animatedPositions[t0][i];
+      // base key frame plus deltas of the vertices that actually move; this
+      // only exercises the layout: blur_triangles rebuilds dense key frames
+      // at commit, so it saves no memory over sharing the mapped ones
+      size_t numTimeSteps = mesh->animatedPositions.size();
+      const vec3f* base = mesh->animatedPositions[0];
+      std::vector<uint8_t> mask(mesh->numPositions, 0);
+      size_t numMoving = 0;
       for (size_t i = 0; i < mesh->numPositions; i++)
-        buffer[1*mesh->numPositions + i] = mesh->animatedPositions[t1][i];
+      {
+        for (size_t t = 1; t < numTimeSteps && !mask[i]; t++)
+          mask[i] = mesh->animatedPositions[t][i] != base[i];
+        numMoving += mask[i];
+      }
+
+      std::vector<vec3f> deltas;
+      deltas.reserve((numTimeSteps-1) * numMoving);
+      for (size_t t = 1; t < numTimeSteps; t++)
+      {
+        for (size_t i = 0; i < mesh->numPositions; i++)
+          if (mask[i])
+            deltas.push_back(mesh->animatedPositions[t][i] - base[i]);
+      }
 
-      OSPData ospPosition = ospNewData(2 * mesh->numPositions, OSP_FLOAT3, buffer.data());
+      OSPData ospPosition = newData(mesh->numPositions, OSP_FLOAT3, base, sizeof(vec3f));
+      ospGeometry.set("position", ospPosition);
+      OSPData ospDelta = ospNewData(deltas.size(), OSP_FLOAT3, deltas.data());
+      ospGeometry.set("vertex.delta", ospDelta);
+      // the geometry holds the only reference to the deltas
+      ospRelease(ospDelta);
+      if (numMoving < mesh->numPositions)
+      {
+        OSPData ospMask = ospNewData(mask.size(), OSP_UCHAR, mask.data());
+        ospGeometry.set("vertex.delta.mask", ospMask);
+        ospRelease(ospMask);
+      }
+      ospGeometry.set("positionTimeSteps", (int)numTimeSteps);
+    }
+    else if (stridedTimeSteps(mesh->animatedPositions, mesh->numPositions, stride, numItems))
+    {
+      OSPData ospPosition = newData(numItems, OSP_FLOAT3, mesh->animatedPositions[0], sizeof(vec3f));
       ospGeometry.set("position", ospPosition);
-      ospGeometry.set("positionTimeSteps", 2);
+      ospGeometry.set("positionTimeSteps", (int)mesh->animatedPositions.size());
+      ospGeometry.set("vertex.timesteps.stride", (int)stride);
     }
     else
     {
-      size_t numTimeSteps = mesh->animatedPositions.size();
-      std::vector<vec3f> buffer(numTimeSteps * mesh->numPositions);
+      // one array per time step, no need to concatenate them
+      std::vector<OSPData> steps;
+      for (const vec3f* positions : mesh->animatedPositions)
+        steps.push_back(newData(mesh->numPositions, OSP_FLOAT3, positions, sizeof(vec3f)));
+
+      OSPData ospPosition = ospNewData(steps.size(), OSP_DATA, steps.data());
+      ospGeometry.set("position", ospPosition);
+    }
+
+    /* drops time steps within the tolerance at commit; the train is
+       forced to two time steps only */
+    if (mesh->animatedPositions.size() > 2)
+    {
+      const float tolerance = istrain ? std::numeric_limits<float>::infinity()
+                                      : timeStepTolerance;
+      if (tolerance > 0.f)
+        ospGeometry.set("vertex.timesteps.tolerance", tolerance);
+    }
+
+    if (mesh->numNormals > 0 && octNormals)
+    {
+      size_t numTimeSteps = std::max(mesh->animatedNormals.size(), size_t(1));
+      std::vector<uint32_t> buffer(numTimeSteps * mesh->numNormals);
       for (size_t t = 0; t < numTimeSteps; t++)
       {
-        for (size_t i = 0; i < mesh->numPositions; i++)
-          buffer[t*mesh->numPositions + i] = mesh->animatedPositions[t][i];
+        const vec3f* normals = mesh->animatedNormals.size() ? mesh->animatedNormals[t] : mesh->normals;
+        for (size_t i = 0; i < mesh->numNormals; i++)
+          buffer[t*mesh->numNormals + i] = octEncode(normals[i]);
       }
 
-      OSPData ospPosition = ospNewData(numTimeSteps * mesh->numPositions, OSP_FLOAT3, buffer.data());
-      ospGeometry.set("position", ospPosition);
-      ospGeometry.set("positionTimeSteps", (int)numTimeSteps);
+      OSPData ospNormal = ospNewData(numTimeSteps * mesh->numNormals, OSP_UINT, buffer.data());
+      ospGeometry.set("normal", ospNormal);
+      if (mesh->animatedNormals.size())
+        ospGeometry.set("normalTimeSteps", (int)numTimeSteps);
     }
-
-    if (mesh->numNormals > 0)
+    else if (mesh->numNormals > 0)
     {
       if (mesh->animatedNormals.size() == 0)
       {
-        OSPData ospNormal = ospNewData(mesh->numNormals, OSP_FLOAT3, mesh->normals);
+        OSPData ospNormal = newData(mesh->numNormals, OSP_FLOAT3, mesh->normals, sizeof(vec3f));
+        ospGeometry.set("normal", ospNormal);
+      }
+      else if (stridedTimeSteps(mesh->animatedNormals, mesh->numNormals, stride, numItems))
+      {
+        OSPData ospNormal = newData(numItems, OSP_FLOAT3, mesh->animatedNormals[0], sizeof(vec3f));
         ospGeometry.set("normal", ospNormal);
+        ospGeometry.set("normalTimeSteps", (int)mesh->animatedNormals.size());
+        ospGeometry.set("normal.timesteps.stride", (int)stride);
       }
       else
       {
-        size_t numTimeSteps = mesh->animatedNormals.size();
-        std::vector<vec3f> buffer(numTimeSteps * mesh->numNormals);
-        for (size_t t = 0; t < numTimeSteps; t++)
-        {
-          for (size_t i = 0; i < mesh->numNormals; i++)
-            buffer[t*mesh->numNormals + i] = mesh->animatedNormals[t][i];
-        }
+        std::vector<OSPData> steps;
+        for (const vec3f* normals : mesh->animatedNormals)
+          steps.push_back(newData(mesh->numNormals, OSP_FLOAT3, normals, sizeof(vec3f)));
 
-        OSPData ospNormal = ospNewData(numTimeSteps * mesh->numNormals, OSP_FLOAT3, buffer.data());
+        OSPData ospNormal = ospNewData(steps.size(), OSP_DATA, steps.data());
         ospGeometry.set("normal", ospNormal);
-        ospGeometry.set("normalTimeSteps", (int)numTimeSteps);
       }
     }
 
     if (mesh->numTexcoords > 0)
     {
-      OSPData texcoord = ospNewData(mesh->numTexcoords, OSP_FLOAT2, mesh->texcoords);
+      OSPData texcoord = newData(mesh->numTexcoords, OSP_FLOAT2, mesh->texcoords, sizeof(vec2f));
       ospGeometry.set("texcoord", texcoord);
     }
 
+    if (mesh->animatedPositions.size() > 1)
+    {
+      ospGeometry.set("shutterOpen", shutter.x);
+      ospGeometry.set("shutterClose", shutter.y);
+    }
+
     ospGeometry.setMaterial(mesh->material);
 
     ospGeometry.commit();
     return ospGeometry;
   }
 
+  void DemoSceneParser::MeshFactory::addOspTriangleMesh(cpp::Model& model,
+                                                        const std::shared_ptr<TriangleMesh>& mesh)
+  {
+    cpp::Geometry ospGeometry = createOspTriangleMesh(mesh);
+    model.addGeometry(ospGeometry);
+    if (mesh->animatedPositions.size() > 1)
+      movingMeshes.emplace_back(ospGeometry, model);
+  }
+
+  void DemoSceneParser::MeshFactory::setShutter(const vec2f& shutter, cpp::Model& sceneModel)
+  {
+    this->shutter = shutter;
+
+    // the models holding moving meshes rebuild their BVHs once all of their
+    // meshes are set; the scene model goes last, its instances refer to them
+    std::vector<cpp::Model> models;
+    for (auto& moving : movingMeshes)
+    {
+      moving.first.set("shutterOpen", shutter.x);
+      moving.first.set("shutterClose", shutter.y);
+      moving.first.commit();
+
+      const OSPModel handle = moving.second.handle();
+      if (handle != sceneModel.handle()
+          && std::none_of(models.begin(), models.end(),
+                          [&](const cpp::Model& m) { return m.handle() == handle; }))
+        models.push_back(moving.second);
+    }
+
+    for (auto& model : models)
+      model.commit();
+    sceneModel.commit();
+  }
+
+  std::function<void(const vec2f&)> DemoSceneParser::shutterWindow() const
+  {
+    bool moving = false;
+    for (const auto& object : scene->objects)
+    {
+      for (const auto& mesh : object->meshes)
+        moving |= mesh->animatedPositions.size() > 1;
+
+      // key framed transforms of flattened objects become moving meshes,
+      // the ones of instances (and of all streamed objects) are blended
+      // over the whole ray time by blur_instance, which the window does
+      // not slice; such scenes keep the real camera shutter
+      if (object->animatedTransforms.empty())
+        continue;
+      if (stream || (!flatten && !object->transforms.empty()))
+        return nullptr;
+      moving = true;
+    }
+    if (!moving)
+      return nullptr;
+
+    auto meshFactory = this->meshFactory;
+    cpp::Model sceneModel = this->sceneModel;
+    return [meshFactory, sceneModel](const vec2f& shutter) mutable {
+      meshFactory->setShutter(shutter, sceneModel);
+    };
+  }
+
   box3f DemoSceneParser::computeTriangleMeshBounds(const std::shared_ptr<TriangleMesh>& mesh)
   {
     box3f bbox = empty;
@@ -23,25 +23,17 @@
 
 #include "apps/common/xml/XML.h"
 
-namespace commandline {
+#include <future>
+#include <vector>
 
-  /* FIXME: data never freed */
-  const ospcommon::vec3f* transform_positions ( const ospcommon::vec3f* in, size_t N,  const ospcommon::affine3f& space)
-  {
-    ospcommon::vec3f* out = new ospcommon::vec3f[N];
-    for (size_t i=0; i<N; i++)
-      out[i] = xfmPoint(space,in[i]);
-    return out;
+namespace ospray {
+  namespace miniSG {
+    struct Texture2D;
+    enum TextureHDRFormat : int;
   }
+}
 
-  /* FIXME: data never freed */
-  const ospcommon::vec3f* transform_normals ( const ospcommon::vec3f* in, size_t N,  const ospcommon::affine3f& space)
-  {
-    ospcommon::vec3f* out = new ospcommon::vec3f[N];
-    for (size_t i=0; i<N; i++)
-      out[i] = xfmNormal(space,in[i]);
-    return out;
-  }
+namespace commandline {
 
   class OSPRAY_COMMANDLINE_INTERFACE DemoSceneParser : public SceneParser
   {
@@ -52,6 +44,8 @@ namespace commandline {
 
     std::deque<ospray::cpp::Model> model() const override;
     std::deque<ospcommon::box3f>   bbox()  const override;
+    std::shared_ptr<ospray::SceneStreamer> streamer() const override;
+    std::function<void(const ospcommon::vec2f &)> shutterWindow() const override;
 
   protected:
 
@@ -76,6 +70,15 @@ namespace commandline {
       std::vector<const ospcommon::vec3f*> animatedPositions;
       std::vector<const ospcommon::vec3f*> animatedNormals;
 
+      /*! arrays transformed for this mesh, freed with it; ospray copies
+          them, so the mesh is dropped once its geometry is created */
+      std::vector<std::vector<ospcommon::vec3f>> transformedArrays;
+
+      /*! transform N positions (or normals) into an array owned by the mesh */
+      const ospcommon::vec3f* transformArray(const ospcommon::vec3f* in, size_t N,
+                                             const ospcommon::affine3f& space,
+                                             bool normals);
+
       TriangleMesh()
         : triangles(nullptr),
           numTriangles(0),
@@ -92,13 +95,13 @@ namespace commandline {
       {
         triangles = other->triangles;
         numTriangles = other->numTriangles;
-        positions = transform_positions(other->positions,other->numPositions,space);
+        positions = transformArray(other->positions,other->numPositions,space,false);
         for (size_t t=0; t<other->animatedPositions.size(); t++)
-          animatedPositions.push_back(transform_positions(other->animatedPositions[t],other->numPositions,space));
+          animatedPositions.push_back(transformArray(other->animatedPositions[t],other->numPositions,space,false));
         numPositions = other->numPositions;
-        normals = transform_normals(other->normals,other->numNormals,space);
+        normals = transformArray(other->normals,other->numNormals,space,true);
         for (size_t t=0; t<other->animatedNormals.size(); t++)
-          animatedNormals.push_back(transform_normals(other->animatedNormals[t],other->numNormals,space));
+          animatedNormals.push_back(transformArray(other->animatedNormals[t],other->numNormals,space,true));
         numNormals = other->numNormals;
         texcoords = other->texcoords;
         numTexcoords = other->numTexcoords;
@@ -110,35 +113,35 @@ namespace commandline {
         triangles = other->triangles;
         numTriangles = other->numTriangles;
 
-        positions = transform_positions(other->positions,other->numPositions,spaces[0]);
+        positions = transformArray(other->positions,other->numPositions,spaces[0],false);
         if (other->animatedPositions.size())
         {
           if (other->animatedPositions.size() != spaces.size())
             throw std::runtime_error("mismatch in temporal resolution of transforms and geometry is not supported");
 
           for (size_t t=0; t<spaces.size(); t++)
-            animatedPositions.push_back(transform_positions(other->animatedPositions[t],other->numPositions,spaces[t]));
+            animatedPositions.push_back(transformArray(other->animatedPositions[t],other->numPositions,spaces[t],false));
         }
         else
         {
           for (size_t t=0; t<spaces.size(); t++)
-            animatedPositions.push_back(transform_positions(other->positions,other->numPositions,spaces[t]));
+            animatedPositions.push_back(transformArray(other->positions,other->numPositions,spaces[t],false));
         }
         numPositions = other->numPositions;
 
-        normals = transform_normals(other->normals,other->numNormals,spaces[0]);
+        normals = transformArray(other->normals,other->numNormals,spaces[0],true);
         if (other->animatedNormals.size())
         {
-          if (other->animatedPositions.size() != spaces.size())
+          if (other->animatedNormals.size() != spaces.size())
             throw std::runtime_error("mismatch in temporal resolution of transforms and geometry is not supported");
 
           for (size_t t=0; t<spaces.size(); t++)
-            animatedNormals.push_back(transform_normals(other->animatedNormals[t],other->numNormals,spaces[t]));
+            animatedNormals.push_back(transformArray(other->animatedNormals[t],other->numNormals,spaces[t],true));
         }
         else
         {
           for (size_t t=0; t<spaces.size(); t++)
-            animatedNormals.push_back(transform_normals(other->normals,other->numNormals,spaces[t]));
+            animatedNormals.push_back(transformArray(other->normals,other->numNormals,spaces[t],true));
         }
         numNormals = other->numNormals;
 
@@ -148,6 +151,17 @@ namespace commandline {
       }
     };
 
+    /*! a part of a mesh too large for 32-bit addressing, owning its data */
+    struct MeshChunk : public TriangleMesh
+    {
+      std::vector<ospcommon::vec3i> chunkTriangles;
+      std::vector<ospcommon::vec3f> chunkPositions;
+      std::vector<ospcommon::vec3f> chunkNormals;
+      std::vector<ospcommon::vec2f> chunkTexcoords;
+      std::vector<std::vector<ospcommon::vec3f>> chunkAnimatedPositions;
+      std::vector<std::vector<ospcommon::vec3f>> chunkAnimatedNormals;
+    };
+
     struct Object
     {
       std::vector<std::shared_ptr<TriangleMesh>> meshes;
@@ -160,27 +174,101 @@ namespace commandline {
       std::vector<std::shared_ptr<Object>> objects;
     };
 
+    /*! how a material was created, such that the scene cache can recreate it */
+    struct MaterialInfo
+    {
+      enum ParamType { FLOAT, FLOAT3, TEXTURE };
+      struct Param
+      {
+        std::string name;
+        ParamType type;
+        ospcommon::vec3f value;
+        int texture; //!< index into textures, -1 if it failed to load
+      };
+
+      std::string id;
+      std::string type;
+      std::vector<Param> params;
+      ospray::cpp::Material material; //!< created at parse, committed at finalize
+      bool committed{false};
+    };
+
+    /*! a texture decoding in the background from when it is first seen */
+    struct TextureInfo
+    {
+      std::string path; //!< of the xml file referencing it
+      std::string fileName;
+      std::shared_future<ospray::miniSG::Texture2D*> texture;
+    };
+
+    /*! creates the ospray meshes; shared with the streamer, which
+        outlives the parser */
+    struct MeshFactory
+    {
+      bool octNormals{false};
+      bool deltaTimeSteps{false};
+      float timeStepTolerance{0.f};
+      /*! mapped .bin files (base, size), data in them can be shared */
+      std::vector<std::pair<const char*, size_t>> binMappings;
+      /*! meshes of these are limited to two time steps */
+      std::vector<OSPMaterial> trainMaterials;
+      /*! the window of the animation moving meshes are built for */
+      ospcommon::vec2f shutter{0.f, 1.f};
+      /*! the moving meshes created so far, with the model holding each;
+          like the window, only touched by the thread creating objects */
+      std::vector<std::pair<ospray::cpp::Geometry, ospray::cpp::Model>> movingMeshes;
+
+      ospray::cpp::Geometry createOspTriangleMesh(const std::shared_ptr<TriangleMesh>& mesh) const;
+      void addOspTriangleMesh(ospray::cpp::Model& model, const std::shared_ptr<TriangleMesh>& mesh);
+      void setShutter(const ospcommon::vec2f& shutter, ospray::cpp::Model& sceneModel);
+      bool isSharable(const void* ptr, size_t numBytes) const;
+      OSPData newData(size_t numItems, OSPDataType type, const void* ptr, size_t itemSize) const;
+      bool stridedTimeSteps(const std::vector<const ospcommon::vec3f*>& steps, size_t numPerStep,
+                            size_t& stride, size_t& numItems) const;
+      std::vector<std::shared_ptr<TriangleMesh>> splitTriangleMesh(const std::shared_ptr<TriangleMesh>& mesh) const;
+      std::shared_ptr<MeshChunk> extractMeshChunk(const std::shared_ptr<TriangleMesh>& mesh, size_t begin, size_t end) const;
+    };
+
     bool flatten{false};
+    bool useCache{false};
+    bool stream{false};
+    int textureMaxSize{0}; //!< of the mip level loaded, 0 loads textures as is
+    ospray::miniSG::TextureHDRFormat textureHDRFormat;
     ospray::cpp::Model sceneModel;
     ospcommon::box3f sceneBounds;
 
     std::shared_ptr<Scene> scene;
     std::map<std::string, std::shared_ptr<Object>> objectMap;
     std::map<std::string, ospray::cpp::Material> materialMap;
+    std::vector<MaterialInfo> materialInfos;
+    std::vector<TextureInfo> textures;
+    std::map<std::string, int> textureIndex; //!< by path/fileName
     OSPMaterial defaultMaterial;
     char* binBasePtr;
+    std::shared_ptr<MeshFactory> meshFactory;
     std::string path;
 
+    /*! loads the objects behind the proxies committed with --stream */
+    class Streamer;
+    std::shared_ptr<Streamer> sceneStreamer;
+
+    std::string findBinFile(const ospcommon::FileName& fileName) const;
+    const char* mapFile(const std::string& fileName);
     void importXml(const ospcommon::FileName& fileName);
+    bool importCache(const ospcommon::FileName& fileName, const ospcommon::FileName& xmlFileName);
+    void writeCache(const ospcommon::FileName& fileName, const ospcommon::FileName& xmlFileName);
     void parseScene(const ospray::xml::Node& node);
     void parseTransform(const ospray::xml::Node& node, bool animated = false);
     std::shared_ptr<TriangleMesh> parseTriangleMesh(const ospray::xml::Node& node);
     std::shared_ptr<Object> parseGroup(const ospray::xml::Node& node);
     ospray::cpp::Material parseMaterial(const ospray::xml::Node& node);
+    void commitMaterial(MaterialInfo& info);
+    void commitMaterials();
+    void createDefaultMaterial();
     void parseAssign(const ospray::xml::Node& node);
 
     void finalize();
-    ospray::cpp::Geometry createOspTriangleMesh(const std::shared_ptr<TriangleMesh>& mesh);
+    void finalizeStreaming(const std::vector<ospcommon::box3f>& objectBounds);
     ospcommon::box3f computeTriangleMeshBounds(const std::shared_ptr<TriangleMesh>& mesh);
     ospcommon::box3f computeInstanceBounds(const ospcommon::box3f& bbox, const ospcommon::affine3f& transform);
   };
@@ -0,0 +1,375 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+/*! \file DemoSceneStreamer.cpp
+
+  With --stream every object is first committed as a box of its bounds,
+  behind a blur_instance per placement. A loader thread then pages in the
+  meshes of one object at a time and splits them into chunks; the render
+  thread creates the object's model from them between frames and points
+  the object's instances at it, as the ospray API is not thread safe.
+
+  Objects in the view frustum are loaded first, nearest first. The others
+  follow by distance, as they can still be seen in shadows and reflections.
+*/
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "ospcommon/common.h"
+#include "DemoSceneParser.h"
+
+namespace commandline {
+
+  using namespace ospray;
+  using namespace ospcommon;
+
+  class DemoSceneParser::Streamer : public SceneStreamer
+  {
+  public:
+
+    /*! an object with the instances placing it */
+    struct Item
+    {
+      std::shared_ptr<Object> object;
+      std::vector<cpp::Geometry> instances;
+      //! world space bounding sphere of each instance over all key frames
+      std::vector<vec4f> spheres;
+    };
+
+    Streamer(std::shared_ptr<MeshFactory> meshFactory,
+             cpp::Model sceneModel,
+             std::vector<Item> items);
+    ~Streamer();
+
+    void start(ScheduleFunction schedule) override;
+    void stop() override;
+    void setView(const vec3f& from, const vec3f& dir, float fovy, float aspect) override;
+
+  private:
+
+    /*! what the loader thread shares with the tasks it schedules, which
+        may still be queued when the streamer is gone */
+    struct Queue
+    {
+      std::mutex mutex;
+      std::condition_variable changed;
+      int numTasks {0};
+    };
+
+    //! objects prepared ahead of the render thread creating them
+    static const int maxQueuedTasks = 2;
+
+    void run();
+    int nextItem();
+    void prefetch(const void* ptr, size_t numBytes) const;
+    void load(const Item& item);
+
+    std::shared_ptr<MeshFactory> meshFactory;
+    cpp::Model sceneModel;
+    std::vector<Item> items;
+    std::vector<bool> loaded;
+
+    ScheduleFunction schedule;
+    std::thread loaderThread;
+    std::atomic<bool> running {false};
+    std::shared_ptr<Queue> queue;
+
+    //! guarded by queue->mutex
+    bool hasView {false};
+    vec3f viewFrom;
+    vec3f viewDir;
+    float viewHalfAngle {0.f}; //!< of the cone around the frustum
+  };
+
+  DemoSceneParser::Streamer::Streamer(std::shared_ptr<MeshFactory> meshFactory,
+                                      cpp::Model sceneModel,
+                                      std::vector<Item> items)
+    : meshFactory(meshFactory),
+      sceneModel(sceneModel),
+      items(std::move(items)),
+      loaded(this->items.size(), false),
+      queue(std::make_shared<Queue>())
+  {
+  }
+
+  DemoSceneParser::Streamer::~Streamer()
+  {
+    stop();
+  }
+
+  void DemoSceneParser::Streamer::start(ScheduleFunction schedule)
+  {
+    if (running)
+      return;
+
+    this->schedule = schedule;
+    running = true;
+    loaderThread = std::thread([this](){ run(); });
+  }
+
+  void DemoSceneParser::Streamer::stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock{queue->mutex};
+      running = false;
+    }
+    queue->changed.notify_all();
+    if (loaderThread.joinable())
+      loaderThread.join();
+  }
+
+  void DemoSceneParser::Streamer::setView(const vec3f& from, const vec3f& dir,
+                                          float fovy, float aspect)
+  {
+    const float tanY = std::tan(0.5f * fovy * float(M_PI) / 180.f);
+    const float tanX = tanY * aspect;
+    {
+      std::lock_guard<std::mutex> lock{queue->mutex};
+      viewFrom = from;
+      viewDir = normalize(dir);
+      viewHalfAngle = std::atan(std::sqrt(tanX*tanX + tanY*tanY));
+      hasView = true;
+    }
+    queue->changed.notify_all();
+  }
+
+  int DemoSceneParser::Streamer::nextItem()
+  {
+    // picked once the render thread caught up, such that the pick uses
+    // the latest view and prepared meshes do not pile up in the queue
+    std::unique_lock<std::mutex> lock{queue->mutex};
+    queue->changed.wait(lock, [&](){
+      return (hasView && queue->numTasks < maxQueuedTasks) || !running;
+    });
+
+    int best = -1;
+    bool bestVisible = false;
+    float bestDistance = std::numeric_limits<float>::infinity();
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      if (loaded[i])
+        continue;
+
+      for (const vec4f& sphere : items[i].spheres)
+      {
+        const vec3f v = vec3f(sphere.x, sphere.y, sphere.z) - viewFrom;
+        const float dist = length(v);
+        const float r = sphere.w;
+
+        // a sphere is in the cone around the frustum if the angle to its
+        // center is less than the cone angle plus the angle it subtends
+        bool visible = dist <= r;
+        if (!visible)
+        {
+          const float angle = std::acos(std::min(std::max(dot(v, viewDir) / dist, -1.f), 1.f));
+          visible = angle - std::asin(r / dist) <= viewHalfAngle;
+        }
+
+        const float distance = std::max(dist - r, 0.f);
+        if ((visible && !bestVisible) || (visible == bestVisible && distance < bestDistance))
+        {
+          best = int(i);
+          bestVisible = visible;
+          bestDistance = distance;
+        }
+      }
+    }
+    return best;
+  }
+
+  void DemoSceneParser::Streamer::prefetch(const void* ptr, size_t numBytes) const
+  {
+    // read ahead the mapped pages of an array, such that building its BVH
+    // does not wait on page faults
+    if (!ptr || !numBytes || !meshFactory->isSharable(ptr, numBytes))
+      return;
+
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t begin = size_t(ptr) & ~(pageSize - 1);
+    const size_t end = size_t(ptr) + numBytes;
+    madvise((void*)begin, end - begin, MADV_WILLNEED);
+  }
+
+  void DemoSceneParser::Streamer::load(const Item& item)
+  {
+    std::vector<std::shared_ptr<TriangleMesh>> chunks;
+    for (const auto& mesh : item.object->meshes)
+    {
+      const size_t positionSteps = std::max(mesh->animatedPositions.size(), size_t(1));
+      const size_t normalSteps = std::max(mesh->animatedNormals.size(), size_t(1));
+      prefetch(mesh->triangles, mesh->numTriangles * sizeof(vec3i));
+      for (size_t t = 0; t < positionSteps; t++)
+        prefetch(t ? mesh->animatedPositions[t] : mesh->positions, mesh->numPositions * sizeof(vec3f));
+      for (size_t t = 0; t < normalSteps; t++)
+        prefetch(t ? mesh->animatedNormals[t] : mesh->normals, mesh->numNormals * sizeof(vec3f));
+      prefetch(mesh->texcoords, mesh->numTexcoords * sizeof(vec2f));
+
+      for (const auto& chunk : meshFactory->splitTriangleMesh(mesh))
+        chunks.push_back(chunk);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{queue->mutex};
+      queue->numTasks++;
+    }
+
+    // the model is not referenced by anything rendered before the task
+    // points the instances at it; the scene model is committed later
+    auto meshFactory = this->meshFactory;
+    auto queue = this->queue;
+    auto instances = item.instances;
+    schedule([meshFactory, queue, instances, chunks]() {
+      cpp::Model model;
+      for (const auto& chunk : chunks)
+        meshFactory->addOspTriangleMesh(model, chunk);
+      model.commit();
+
+      for (auto instance : instances)
+      {
+        instance.set("model", model.handle());
+        instance.commit();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock{queue->mutex};
+        queue->numTasks--;
+      }
+      queue->changed.notify_all();
+    });
+  }
+
+  void DemoSceneParser::Streamer::run()
+  {
+    // the scene model is committed once per batch of objects, rather than
+    // once per object, as that rebuilds the top level BVH
+    const double batchTime = 0.1;
+    double batchStart = getSysTime();
+    bool pending = false;
+    cpp::Model sceneModel = this->sceneModel;
+    auto commitScene = [sceneModel]() mutable { sceneModel.commit(); };
+
+    while (running)
+    {
+      const int i = nextItem();
+      if (i < 0 || !running)
+        break;
+
+      load(items[i]);
+      loaded[i] = true;
+      pending = true;
+
+      if (getSysTime() - batchStart > batchTime)
+      {
+        schedule(commitScene);
+        batchStart = getSysTime();
+        pending = false;
+      }
+    }
+
+    if (pending)
+      schedule(commitScene);
+  }
+
+  std::shared_ptr<SceneStreamer> DemoSceneParser::streamer() const
+  {
+    return sceneStreamer;
+  }
+
+  void DemoSceneParser::finalizeStreaming(const std::vector<box3f>& objectBounds)
+  {
+    sceneBounds = empty;
+
+    std::vector<Streamer::Item> items;
+    for (size_t i = 0; i < scene->objects.size(); i++)
+    {
+      const auto& object = scene->objects[i];
+      const box3f& b = objectBounds[i];
+      if (b.lower.x > b.upper.x)
+        continue;
+
+      // the proxy is the box of the object, in the object's space
+      std::vector<vec3f> corners;
+      for (int c = 0; c < 8; c++)
+        corners.push_back(vec3f(c & 1 ? b.upper.x : b.lower.x,
+                                c & 2 ? b.upper.y : b.lower.y,
+                                c & 4 ? b.upper.z : b.lower.z));
+      const std::vector<vec3i> faces = {
+        {0,2,1}, {1,2,3}, {4,5,6}, {5,7,6}, {0,1,4}, {1,5,4},
+        {2,6,3}, {3,6,7}, {0,4,2}, {2,4,6}, {1,3,5}, {3,7,5}
+      };
+
+      auto box = std::make_shared<TriangleMesh>();
+      box->triangles = faces.data();
+      box->numTriangles = faces.size();
+      box->positions = corners.data();
+      box->numPositions = corners.size();
+      box->material = defaultMaterial;
+
+      cpp::Model proxy;
+      proxy.addGeometry(meshFactory->createOspTriangleMesh(box));
+      proxy.commit();
+
+      Streamer::Item item;
+      item.object = object;
+
+      auto addInstance = [&](const affine3f* xfms, size_t numKeys) {
+        cpp::Geometry ospInstance("blur_instance");
+        ospInstance.set("model", proxy.handle());
+        OSPData ospXfm = ospNewData(numKeys * 4, OSP_FLOAT3, xfms);
+        ospInstance.set("xfm", ospXfm);
+        ospInstance.commit();
+        sceneModel.addGeometry(ospInstance);
+
+        box3f bounds = empty;
+        for (size_t k = 0; k < numKeys; k++)
+          bounds.extend(computeInstanceBounds(b, xfms[k]));
+        sceneBounds.extend(bounds);
+
+        const vec3f center = 0.5f * (bounds.lower + bounds.upper);
+        item.spheres.push_back(vec4f(center.x, center.y, center.z,
+                                     0.5f * length(bounds.upper - bounds.lower)));
+        item.instances.push_back(ospInstance);
+      };
+
+      if (object->animatedTransforms.size())
+      {
+        for (const auto& transforms : object->animatedTransforms)
+          addInstance(transforms.data(), transforms.size());
+      }
+      else if (object->transforms.size())
+      {
+        for (const auto& transform : object->transforms)
+          addInstance(&transform, 1);
+      }
+      else
+      {
+        const affine3f identity = one;
+        addInstance(&identity, 1);
+      }
+
+      items.push_back(item);
+    }
+
+    sceneStreamer = std::make_shared<Streamer>(meshFactory, sceneModel, std::move(items));
+  }
+
+} // ::commandline
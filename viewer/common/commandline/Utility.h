@@ -50,7 +50,9 @@ namespace commandline {
             typename CameraParser_T,
             typename SceneParser_T,
             typename LightsParser_T>
-  inline ParsedOSPObjects parseCommandLine(int ac, const char **&av)
+  inline ParsedOSPObjects parseCommandLine(int ac, const char **&av,
+                                           std::shared_ptr<ospray::SceneStreamer> *streamer = nullptr,
+                                           std::function<void(const ospcommon::vec2f &)> *shutterWindow = nullptr)
   {
     static_assert(std::is_base_of<RendererParser, RendererParser_T>::value,
                   "RendererParser_T is not a subclass of RendererParser.");
@@ -75,6 +77,10 @@ namespace commandline {
     sceneParser.parse(ac, av);
     auto model = sceneParser.model();
     auto bbox  = sceneParser.bbox();
+    if (streamer)
+      *streamer = sceneParser.streamer();
+    if (shutterWindow)
+      *shutterWindow = sceneParser.shutterWindow();
 
     LightsParser_T lightsParser(renderer);
     lightsParser.parse(ac, av);
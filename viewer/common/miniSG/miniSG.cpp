@@ -19,6 +19,17 @@
 
 #include "ospray/common/OSPCommon.h"
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
@@ -55,17 +66,43 @@ namespace ospray {
       // setParam( "Ka", vec3f(0.f) );
     }
 
-    Texture2D *loadTexture(const std::string &_path,
-                           const std::string &fileNameBase,
-                           const bool prefereLinear)
+    // flip in y, because OSPRay's textures have the origin at the lower left corner
+    static void flipRows(void *data, size_t height, size_t stride)
+    {
+      unsigned char *texels = (unsigned char *)data;
+      for (size_t y = 0; y < height / 2; y++)
+        std::swap_ranges(&texels[y * stride], &texels[(y + 1) * stride],
+                         &texels[(height - 1 - y) * stride]);
+    }
+
+    static size_t texelBytes(const Texture2D *tex)
+    {
+      return size_t(tex->width) * tex->height * tex->channels * tex->depth;
+    }
+
+    // ospray has no two channel texel formats, gray+alpha becomes RGBA
+    template <typename T>
+    static void expandGrayAlpha(Texture2D *tex)
+    {
+      const size_t numTexels = size_t(tex->width) * tex->height;
+      const T *src = (const T *)tex->data;
+      T *dst = (T *)new unsigned char[numTexels * 4 * sizeof(T)];
+      for (size_t i = 0; i < numTexels; i++) {
+        dst[4*i+0] = dst[4*i+1] = dst[4*i+2] = src[2*i+0];
+        dst[4*i+3] = src[2*i+1];
+      }
+      delete [] (unsigned char *)tex->data;
+      tex->data = dst;
+      tex->channels = 4;
+    }
+
+    static Texture2D *decodeTexture(const std::string &_path,
+                                    const std::string &fileNameBase,
+                                    const bool prefereLinear)
     {
       std::string path = _path;
       FileName fileName = path+"/"+fileNameBase;
 
-      static std::map<std::string,Texture2D*> textureCache;
-      if (textureCache.find(fileName.str()) != textureCache.end())
-        return textureCache[fileName.str()];
-
       Texture2D *tex = nullptr;
 #if USE_OPENIMAGEIO
       ImageInput *in = ImageInput::open(fileName.str().c_str());
@@ -88,14 +125,7 @@ namespace ospray {
         in->close();
         ImageInput::destroy(in);
 
-        // flip image (because OSPRay's textures have the origin at the lower left corner)
-        unsigned char* data = (unsigned char*)tex->data;
-        for (size_t y = 0; y < tex->height / 2; y++) {
-          unsigned char *src = &data[y * stride];
-          unsigned char *dest = &data[(tex->height-1-y) * stride];
-          for (size_t x = 0; x < stride; x++)
-            std::swap(src[x], dest[x]);
-        }
+        flipRows(tex->data, tex->height, stride);
       }
 #else
       const std::string ext = fileName.ext();
@@ -214,11 +244,8 @@ namespace ospray {
           tex->prefereLinear = prefereLinear;
           tex->data     = new unsigned char[width*height*3];
           rc = fread(tex->data,width*height*3,1,file);
-          // flip in y, because OSPRay's textures have the origin at the lower left corner
-          unsigned char *texels = (unsigned char *)tex->data;
-          for (int y = 0; y < height/2; y++)
-            for (int x = 0; x < width*3; x++)
-              std::swap(texels[y*width*3+x], texels[(height-1-y)*width*3+x]);
+          fclose(file);
+          flipRows(tex->data, height, width*3);
       }
         } catch(std::runtime_error e) {
           std::cerr << e.what() << std::endl;
@@ -279,20 +306,16 @@ namespace ospray {
           tex->channels = numChannels;
           tex->depth    = sizeof(float);
           tex->prefereLinear = prefereLinear;
-          tex->data     = new float[width * height * numChannels];
-          if (fread(tex->data, sizeof(float), width * height * numChannels, file)
-              != width * height * numChannels)
+          tex->data     = new unsigned char[width * height * numChannels * sizeof(float)];
+          const size_t numRead = fread(tex->data, sizeof(float), width * height * numChannels, file);
+          fclose(file);
+          if (numRead != size_t(width * height * numChannels))
             throw std::runtime_error("could not fread");
-          // flip in y, because OSPRay's textures have the origin at the lower left corner
+          // Scale the pixels by the scale factor
           float *texels = (float *)tex->data;
-          for (int y = 0; y < height / 2; ++y) {
-            for (int x = 0; x < width * numChannels; ++x) {
-              // Scale the pixels by the scale factor
-              texels[y * width * numChannels + x] = texels[y * width * numChannels + x] * scaleFactor;
-              texels[(height - 1 - y) * width * numChannels + x] = texels[(height - 1 - y) * width * numChannels + x] * scaleFactor;
-              std::swap(texels[y * width * numChannels + x], texels[(height - 1 - y) * width * numChannels + x]);
-            }
-          }
+          for (size_t i = 0; i < size_t(width) * height * numChannels; i++)
+            texels[i] *= scaleFactor;
+          flipRows(tex->data, height, width * numChannels * sizeof(float));
         } catch(std::runtime_error e) {
           std::cerr << e.what() << std::endl;
         }
@@ -351,44 +374,594 @@ namespace ospray {
         tex->channels = n;
         tex->depth    = hdr ? 4 : 1;
         tex->prefereLinear = prefereLinear;
-        unsigned char MaxRGB = 1;
-        float rcpMaxRGB = 1.0f/float(MaxRGB);
         if (!pixels) {
           std::cerr << "#osp:minisg: failed to load texture '"+fileName.str()+"'" << std::endl;
           delete tex;
           tex = nullptr;
         } else {
-          tex->data = new unsigned char[tex->width*tex->height*tex->channels*tex->depth];
-          // convert pixels and flip image (because OSPRay's textures have the origin at the lower left corner)
-          for (size_t y=0; y<tex->height; y++) {
-            for (size_t x=0; x<tex->width; x++) {
-              const unsigned char *pixel = &pixels[(y*tex->width+x)*tex->channels];
-              if (hdr) {
-                printf("loading hdr image\n");
-                float *dst = &((float*)tex->data)[(x+(tex->height-1-y)*tex->width)*tex->channels];
-                *dst++ = pixel[0] * rcpMaxRGB;
-                *dst++ = pixel[1] * rcpMaxRGB;
-                *dst++ = pixel[2] * rcpMaxRGB;
-                if (tex->channels == 4)
-                  *dst++ = pixel[3] * rcpMaxRGB;
+          // stb decodes into the texel format already, only flip the
+          // rows (because OSPRay's textures have the origin at the lower left corner)
+          const size_t stride = size_t(tex->width) * tex->channels * tex->depth;
+          tex->data = new unsigned char[tex->height * stride];
+          for (size_t y=0; y<tex->height; y++)
+            memcpy((unsigned char*)tex->data + (tex->height-1-y) * stride, pixels + y * stride, stride);
+          stbi_image_free(pixels);
+        }
+#endif
+      }
+#endif
+      if (tex && tex->channels == 2) {
+        if (tex->depth == 4)
+          expandGrayAlpha<float>(tex);
+        else
+          expandGrayAlpha<unsigned char>(tex);
+      }
+      return tex;
+    }
+
+    // texture preprocessing: mip chains cached next to the source ///////////
+
+    static const uint32_t mipCacheVersion = 2; // 2: gray+alpha expanded to RGBA
+    static const char mipCacheMagic[8] = "OSPMIPS";
+
+    //! how the texels of the levels are stored in the cache file
+    enum MipStorage { MIP_RAW, MIP_HALF, MIP_RGBE };
+
+    struct MipHeader
+    {
+      char magic[8];
+      uint32_t version;
+      int32_t prefereLinear; //!< the levels of sRGB textures are filtered linearly
+      int32_t hdrFormat;     //!< requested when the cache was written
+      uint64_t srcSize;      //!< size and modification time of the source
+      int64_t srcTime;
+      int32_t channels;
+      int32_t depth;
+      int32_t storage;       //!< MipStorage picked for the texel format
+      int32_t numLevels;
+    };
+
+    struct MipLevel
+    {
+      int32_t width;
+      int32_t height;
+      uint64_t ofs;
+      uint64_t numBytes;
+    };
+
+    static float srgbToLinear(float v)
+    {
+      return v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+    }
+
+    static float linearToSrgb(float v)
+    {
+      return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.f / 2.4f) - 0.055f;
+    }
+
+    static uint16_t floatToHalf(float f)
+    {
+      uint32_t x;
+      memcpy(&x, &f, 4);
+      const uint32_t sign = (x >> 16) & 0x8000;
+      const int32_t exp = int32_t((x >> 23) & 0xff) - 127 + 15;
+      uint32_t mant = x & 0x7fffff;
+      if (((x >> 23) & 0xff) == 0xff) // inf, nan
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+      if (exp >= 31)
+        return sign | 0x7c00;
+      if (exp <= 0) {
+        if (exp < -10)
+          return sign;
+        mant |= 0x800000;
+        return sign | ((mant >> (14 - exp)) + ((mant >> (13 - exp)) & 1));
+      }
+      return (sign | (exp << 10) | (mant >> 13)) + ((mant >> 12) & 1);
+    }
+
+    static float halfToFloat(uint16_t h)
+    {
+      const uint32_t sign = uint32_t(h & 0x8000) << 16;
+      uint32_t exp = (h >> 10) & 0x1f;
+      uint32_t mant = h & 0x3ff;
+      uint32_t x;
+      if (exp == 0x1f) {
+        x = sign | 0x7f800000 | (mant << 13);
+      } else if (exp == 0) {
+        if (mant == 0) {
+          x = sign;
+        } else {
+          // renormalize the denormal
+          exp = 127 - 15 + 1;
+          while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+          }
+          x = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+        }
+      } else {
+        x = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+      }
+      float f;
+      memcpy(&f, &x, 4);
+      return f;
+    }
+
+    // Ward's shared exponent encoding, negative values are clamped to zero
+    static void floatToRgbe(const float *rgb, unsigned char *rgbe)
+    {
+      const float r = std::max(rgb[0], 0.f);
+      const float g = std::max(rgb[1], 0.f);
+      const float b = std::max(rgb[2], 0.f);
+      const float v = std::max(r, std::max(g, b));
+      if (v < 1e-32f) {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+        return;
+      }
+      int e;
+      const float scale = std::frexp(v, &e) * 256.f / v;
+      rgbe[0] = (unsigned char)std::min(r * scale, 255.f);
+      rgbe[1] = (unsigned char)std::min(g * scale, 255.f);
+      rgbe[2] = (unsigned char)std::min(b * scale, 255.f);
+      rgbe[3] = (unsigned char)(e + 128);
+    }
+
+    static void rgbeToFloat(const unsigned char *rgbe, float *rgb)
+    {
+      if (rgbe[3] == 0) {
+        rgb[0] = rgb[1] = rgb[2] = 0.f;
+        return;
+      }
+      const float f = std::ldexp(1.f, int(rgbe[3]) - (128 + 8));
+      rgb[0] = (rgbe[0] + 0.5f) * f;
+      rgb[1] = (rgbe[1] + 0.5f) * f;
+      rgb[2] = (rgbe[2] + 0.5f) * f;
+    }
+
+    //! the next level of the chain, a 2x2 box filter
+    static Texture2D *downsample(const Texture2D *src)
+    {
+      // filter the color of sRGB textures in linear space, like they are
+      // sampled; createTexture2D picks sRGB for 8 bit RGB(A) textures
+      const bool srgb = src->depth == 1 && src->channels >= 3 && !src->prefereLinear;
+      float srgbTable[256];
+      for (int i = 0; srgb && i < 256; i++)
+        srgbTable[i] = srgbToLinear(i / 255.f);
+
+      Texture2D *dst = new Texture2D;
+      dst->width    = std::max(src->width / 2, 1);
+      dst->height   = std::max(src->height / 2, 1);
+      dst->channels = src->channels;
+      dst->depth    = src->depth;
+      dst->prefereLinear = src->prefereLinear;
+      dst->data     = new unsigned char[texelBytes(dst)];
+
+      const int c = src->channels;
+      for (int y = 0; y < dst->height; y++) {
+        const int y0 = std::min(2 * y, src->height - 1);
+        const int y1 = std::min(2 * y + 1, src->height - 1);
+        for (int x = 0; x < dst->width; x++) {
+          const int x0 = std::min(2 * x, src->width - 1);
+          const int x1 = std::min(2 * x + 1, src->width - 1);
+          const size_t i00 = (size_t(y0) * src->width + x0) * c;
+          const size_t i01 = (size_t(y0) * src->width + x1) * c;
+          const size_t i10 = (size_t(y1) * src->width + x0) * c;
+          const size_t i11 = (size_t(y1) * src->width + x1) * c;
+          const size_t o = (size_t(y) * dst->width + x) * c;
+          for (int ch = 0; ch < c; ch++) {
+            if (src->depth == 4) {
+              const float *s = (const float *)src->data;
+              ((float *)dst->data)[o + ch] =
+                0.25f * (s[i00 + ch] + s[i01 + ch] + s[i10 + ch] + s[i11 + ch]);
+            } else {
+              const unsigned char *s = (const unsigned char *)src->data;
+              const bool color = srgb && ch < 3;
+              float v = 0.25f * (color ? srgbTable[s[i00 + ch]] + srgbTable[s[i01 + ch]]
+                                         + srgbTable[s[i10 + ch]] + srgbTable[s[i11 + ch]]
+                                       : (s[i00 + ch] + s[i01 + ch]
+                                          + s[i10 + ch] + s[i11 + ch]) / 255.f);
+              if (color)
+                v = linearToSrgb(v);
+              ((unsigned char *)dst->data)[o + ch] =
+                (unsigned char)std::min(std::max(v * 255.f + 0.5f, 0.f), 255.f);
+            }
+          }
+        }
+      }
+      return dst;
+    }
+
+    static int mipStorage(const Texture2D *tex, TextureHDRFormat hdrFormat)
+    {
+      if (tex->depth != 4 || hdrFormat == TEXTURE_HDR_FLOAT)
+        return MIP_RAW;
+      return hdrFormat == TEXTURE_HDR_RGBE && tex->channels == 3 ? MIP_RGBE : MIP_HALF;
+    }
+
+    static size_t storedBytes(const Texture2D *tex, int storage)
+    {
+      const size_t numTexels = size_t(tex->width) * tex->height;
+      switch (storage) {
+      case MIP_HALF: return numTexels * tex->channels * 2;
+      case MIP_RGBE: return numTexels * 4;
+      default:       return texelBytes(tex);
+      }
+    }
+
+    static void writeMipCache(const std::string &cacheName,
+                              const MipHeader &header,
+                              const std::vector<Texture2D *> &levels)
+    {
+      // best effort: the source directory may not be writable
+      const std::string tmpName = cacheName + ".tmp";
+      FILE *file = fopen(tmpName.c_str(), "wb");
+      if (!file)
+        return;
+
+      std::vector<MipLevel> table;
+      uint64_t ofs = sizeof(MipHeader) + levels.size() * sizeof(MipLevel);
+      for (const Texture2D *level : levels) {
+        const uint64_t numBytes = storedBytes(level, header.storage);
+        table.push_back({level->width, level->height, ofs, numBytes});
+        ofs += numBytes;
+      }
+      fwrite(&header, sizeof(header), 1, file);
+      fwrite(table.data(), sizeof(MipLevel), table.size(), file);
+
+      for (const Texture2D *level : levels) {
+        const size_t numTexels = size_t(level->width) * level->height;
+        const float *texels = (const float *)level->data;
+        if (header.storage == MIP_HALF) {
+          std::vector<uint16_t> half(numTexels * level->channels);
+          for (size_t i = 0; i < half.size(); i++)
+            half[i] = floatToHalf(texels[i]);
+          fwrite(half.data(), 2, half.size(), file);
+        } else if (header.storage == MIP_RGBE) {
+          std::vector<unsigned char> rgbe(numTexels * 4);
+          for (size_t i = 0; i < numTexels; i++)
+            floatToRgbe(&texels[i * 3], &rgbe[i * 4]);
+          fwrite(rgbe.data(), 1, rgbe.size(), file);
+        } else {
+          fwrite(level->data, 1, texelBytes(level), file);
+        }
+      }
+
+      const bool failed = ferror(file);
+      fclose(file);
+      if (failed || rename(tmpName.c_str(), cacheName.c_str()) != 0)
+        remove(tmpName.c_str());
+    }
+
+    //! reads the first level no larger than maxSize from an up to date cache
+    static Texture2D *readMipCache(const std::string &cacheName,
+                                   const MipHeader &expected,
+                                   int maxSize)
+    {
+      FILE *file = fopen(cacheName.c_str(), "rb");
+      if (!file)
+        return nullptr;
+
+      MipHeader header;
+      std::vector<MipLevel> table;
+      Texture2D *tex = nullptr;
+      if (fread(&header, sizeof(header), 1, file) == 1
+          && memcmp(header.magic, mipCacheMagic, sizeof(header.magic)) == 0
+          && header.version == expected.version
+          && header.prefereLinear == expected.prefereLinear
+          && header.hdrFormat == expected.hdrFormat
+          && header.srcSize == expected.srcSize
+          && header.srcTime == expected.srcTime
+          && header.storage >= MIP_RAW && header.storage <= MIP_RGBE
+          && (header.depth == 1 || header.depth == 4)
+          && (header.storage == MIP_RAW || header.depth == 4)
+          && (header.storage != MIP_RGBE || header.channels == 3)
+          && header.numLevels > 0 && header.numLevels <= 32) {
+        table.resize(header.numLevels);
+        if (fread(table.data(), sizeof(MipLevel), table.size(), file) == table.size()) {
+          size_t l = 0;
+          while (l + 1 < table.size()
+                 && std::max(table[l].width, table[l].height) > maxSize)
+            l++;
+
+          tex = new Texture2D;
+          tex->width    = table[l].width;
+          tex->height   = table[l].height;
+          tex->channels = header.channels;
+          tex->depth    = header.depth;
+          tex->prefereLinear = header.prefereLinear;
+          if (table[l].numBytes != storedBytes(tex, header.storage)) {
+            delete tex;
+            tex = nullptr;
+          } else {
+            std::vector<unsigned char> stored(table[l].numBytes);
+            if (fseek(file, table[l].ofs, SEEK_SET) != 0
+                || fread(stored.data(), 1, stored.size(), file) != stored.size()) {
+              delete tex;
+              tex = nullptr;
+            } else {
+              const size_t numTexels = size_t(tex->width) * tex->height;
+              tex->data = new unsigned char[texelBytes(tex)];
+              float *texels = (float *)tex->data;
+              if (header.storage == MIP_HALF) {
+                const uint16_t *half = (const uint16_t *)stored.data();
+                for (size_t i = 0; i < numTexels * tex->channels; i++)
+                  texels[i] = halfToFloat(half[i]);
+              } else if (header.storage == MIP_RGBE) {
+                for (size_t i = 0; i < numTexels; i++)
+                  rgbeToFloat(&stored[i * 4], &texels[i * 3]);
               } else {
-                unsigned char *dst = &((unsigned char*)tex->data)[((tex->height-1-y)*tex->width+x)*tex->channels];
-                *dst++ = pixel[0];
-                *dst++ = pixel[1];
-                *dst++ = pixel[2];
-                if (tex->channels == 4)
-                  *dst++ = pixel[3];
+                memcpy(tex->data, stored.data(), stored.size());
               }
             }
           }
         }
-#endif
       }
-#endif
-      textureCache[fileName.str()] = tex;
+      fclose(file);
       return tex;
     }
 
+    /*! loads the first level of the texture's mip chain no larger than
+        maxSize, from the cache next to the source; the chain is built and
+        cached if the cache is missing or out of date */
+    static Texture2D *loadMipLevel(const std::string &path,
+                                   const std::string &fileNameBase,
+                                   const bool prefereLinear,
+                                   int maxSize,
+                                   TextureHDRFormat hdrFormat)
+    {
+      const std::string fileName = FileName(path+"/"+fileNameBase).str();
+      const std::string cacheName = fileName + ".mips";
+
+      struct stat st;
+      if (stat(fileName.c_str(), &st) != 0)
+        return decodeTexture(path, fileNameBase, prefereLinear);
+
+      MipHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, mipCacheMagic, sizeof(header.magic));
+      header.version = mipCacheVersion;
+      header.prefereLinear = prefereLinear;
+      header.hdrFormat = hdrFormat;
+      header.srcSize = st.st_size;
+      header.srcTime = st.st_mtime;
+
+      Texture2D *tex = readMipCache(cacheName, header, maxSize);
+      if (tex)
+        return tex;
+
+      Texture2D *src = decodeTexture(path, fileNameBase, prefereLinear);
+      if (!src)
+        return nullptr;
+
+      std::vector<Texture2D *> levels {src};
+      while (levels.back()->width > 1 || levels.back()->height > 1)
+        levels.push_back(downsample(levels.back()));
+
+      header.channels  = src->channels;
+      header.depth     = src->depth;
+      header.storage   = mipStorage(src, hdrFormat);
+      header.numLevels = levels.size();
+      writeMipCache(cacheName, header, levels);
+
+      size_t l = 0;
+      while (l + 1 < levels.size()
+             && std::max(levels[l]->width, levels[l]->height) > maxSize)
+        l++;
+      for (size_t i = 0; i < levels.size(); i++) {
+        if (i == l)
+          continue;
+        delete [] (unsigned char *)levels[i]->data;
+        delete levels[i];
+      }
+      return levels[l];
+    }
+
+    // texture decoding on worker threads, with a bounded cache //////////////
+
+    namespace {
+
+      /*! a few threads decoding textures off the parsing thread */
+      class TextureDecoder
+      {
+      public:
+        TextureDecoder()
+        {
+          const int numThreads = std::max(2u, std::thread::hardware_concurrency());
+          for (int i = 0; i < numThreads; i++)
+            threads.emplace_back([this](){ run(); });
+        }
+
+        ~TextureDecoder()
+        {
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+          }
+          wakeup.notify_all();
+          for (auto &thread : threads)
+            thread.join();
+        }
+
+        void schedule(std::function<void()> task)
+        {
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+          }
+          wakeup.notify_one();
+        }
+
+      private:
+        void run()
+        {
+          while (true) {
+            std::function<void()> task;
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              wakeup.wait(lock, [&](){ return stopping || !tasks.empty(); });
+              if (tasks.empty())
+                return;
+              task = std::move(tasks.front());
+              tasks.pop_front();
+            }
+            task();
+          }
+        }
+
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool stopping {false};
+      };
+
+      struct CachedTexture
+      {
+        Texture2D *texture {nullptr}; //!< stays valid, its texels may be freed
+        std::shared_future<Texture2D *> decoded;
+        size_t numBytes {0};          //!< of the texels currently held
+        bool uploaded {false};        //!< passed to createTexture2D
+        bool decoding {false};
+        std::list<std::string>::iterator lru;
+      };
+
+      struct TextureCache
+      {
+        std::mutex mutex;
+        std::map<std::string, CachedTexture> entries;
+        std::map<Texture2D *, std::string> names;
+        std::list<std::string> lru; //!< most recently used first
+        size_t budget {size_t(1) << 30};
+        size_t numBytes {0};
+        int maxSize {0}; //!< of the mip level loaded, 0 loads the source as is
+        TextureHDRFormat hdrFormat {TEXTURE_HDR_RGBE};
+
+        //! frees the texels of the least recently used uploaded textures
+        //! beyond the budget, except for the most recently used one
+        void evict()
+        {
+          for (auto it = lru.rbegin(); numBytes > budget && it != lru.rend(); ++it) {
+            if (*it == lru.front())
+              break;
+            CachedTexture &entry = entries[*it];
+            if (!entry.uploaded || !entry.texture || !entry.texture->data)
+              continue;
+            delete [] (unsigned char *)entry.texture->data;
+            entry.texture->data = nullptr;
+            numBytes -= entry.numBytes;
+            entry.numBytes = 0;
+          }
+        }
+      };
+
+      // the cache outlives the decoder, which is created after it
+      TextureCache &textureCache()
+      {
+        static TextureCache cache;
+        return cache;
+      }
+
+      TextureDecoder &textureDecoder()
+      {
+        static TextureDecoder decoder;
+        return decoder;
+      }
+
+    } // ::ospray::miniSG::<anonymous>
+
+    std::shared_future<Texture2D *> loadTextureAsync(const std::string &path,
+                                                     const std::string &fileNameBase,
+                                                     const bool prefereLinear)
+    {
+      TextureCache &cache = textureCache();
+      TextureDecoder &decoder = textureDecoder();
+      const std::string key = FileName(path+"/"+fileNameBase).str();
+
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      auto it = cache.entries.find(key);
+      if (it != cache.entries.end()) {
+        CachedTexture &entry = it->second;
+        cache.lru.splice(cache.lru.begin(), cache.lru, entry.lru);
+        // texels freed by the cache are decoded again, into the texture
+        // handed out before
+        const bool evicted = entry.texture && !entry.texture->data;
+        if (!evicted || entry.decoding)
+          return entry.decoded;
+      } else {
+        CachedTexture &entry = cache.entries[key];
+        cache.lru.push_front(key);
+        entry.lru = cache.lru.begin();
+      }
+
+      const int maxSize = cache.maxSize;
+      const TextureHDRFormat hdrFormat = cache.hdrFormat;
+      auto promise = std::make_shared<std::promise<Texture2D *>>();
+      cache.entries[key].decoded = promise->get_future().share();
+      cache.entries[key].decoding = true;
+
+      decoder.schedule([=, &cache](){
+        Texture2D *tex = nullptr;
+        try {
+          tex = maxSize > 0
+            ? loadMipLevel(path, fileNameBase, prefereLinear, maxSize, hdrFormat)
+            : decodeTexture(path, fileNameBase, prefereLinear);
+        } catch (...) {
+          {
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            cache.entries[key].decoding = false;
+          }
+          promise->set_exception(std::current_exception());
+          return;
+        }
+
+        {
+          std::lock_guard<std::mutex> lock(cache.mutex);
+          CachedTexture &entry = cache.entries[key];
+          entry.decoding = false;
+          if (entry.texture && tex) {
+            entry.texture->data = tex->data;
+            tex->data = nullptr;
+            delete tex;
+            tex = entry.texture;
+          } else if (tex) {
+            entry.texture = tex;
+            cache.names[tex] = key;
+          }
+          if (tex) {
+            entry.numBytes = texelBytes(tex);
+            cache.numBytes += entry.numBytes;
+            cache.evict();
+          }
+        }
+        promise->set_value(tex);
+      });
+
+      return cache.entries[key].decoded;
+    }
+
+    Texture2D *loadTexture(const std::string &path,
+                           const std::string &fileNameBase,
+                           const bool prefereLinear)
+    {
+      return loadTextureAsync(path, fileNameBase, prefereLinear).get();
+    }
+
+    void setTextureCacheBudget(size_t numBytes)
+    {
+      TextureCache &cache = textureCache();
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      cache.budget = numBytes;
+      cache.evict();
+    }
+
+    void setTexturePreprocessing(int maxSize, TextureHDRFormat hdrFormat)
+    {
+      TextureCache &cache = textureCache();
+      std::lock_guard<std::mutex> lock(cache.mutex);
+      cache.maxSize = maxSize;
+      cache.hdrFormat = hdrFormat;
+    }
+
 
     float Material::getParam(const char *name, float defaultVal)
     {
@@ -633,6 +1206,16 @@ namespace ospray {
         if( msgTex->channels == 4 ) type = OSP_TEXTURE_RGBA32F;
       }
 
+      if ((msgTex->depth != 1 && msgTex->depth != 4)
+          || (msgTex->channels != 1 && msgTex->channels != 3
+              && msgTex->channels != 4)) {
+        std::cerr << "#osp:minisg: unsupported texel format ("
+                  << msgTex->channels << " channels, " << msgTex->depth
+                  << " bytes each), texture skipped" << std::endl;
+        alreadyCreatedTextures[msgTex] = NULL;
+        return NULL;
+      }
+
       vec2i texSize(msgTex->width, msgTex->height);
       OSPTexture2D ospTex = ospNewTexture2D( (osp::vec2i&)texSize,
                                              type,
@@ -641,6 +1224,17 @@ namespace ospray {
 
       alreadyCreatedTextures[msgTex] = ospTex;
 
+      // OSPRay holds a copy of the texels now, the cache may free its own
+      {
+        TextureCache &cache = textureCache();
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto name = cache.names.find(msgTex);
+        if (name != cache.names.end()) {
+          cache.entries[name->second].uploaded = true;
+          cache.evict();
+        }
+      }
+
       ospCommit(ospTex);
       //g_tex = ospTex; // remember last texture for debugging
 
@@ -28,6 +28,7 @@
 // stl 
 #include <vector>
 #include <map>
+#include <future>
 
 #ifdef _WIN32
 #  ifdef ospray_minisg_EXPORTS
@@ -61,6 +62,29 @@ namespace ospray {
     
     OSPMINISG_INTERFACE Texture2D *loadTexture(const std::string &path, const std::string &fileName, const bool prefereLinear = false);
 
+    /*! starts decoding the texture on a worker thread, loadTexture and
+        loadTextureAsync of the same file share the result */
+    OSPMINISG_INTERFACE std::shared_future<Texture2D *> loadTextureAsync(const std::string &path, const std::string &fileName, const bool prefereLinear = false);
+
+    /*! bytes of texels kept for textures already passed to
+        createTexture2D; beyond it the least recently used are freed, and
+        decoded again if loaded again */
+    OSPMINISG_INTERFACE void setTextureCacheBudget(size_t numBytes);
+
+    /*! how HDR texels are stored in the mip cache, they are float again
+        once loaded */
+    enum TextureHDRFormat : int {
+      TEXTURE_HDR_FLOAT,
+      TEXTURE_HDR_HALF,
+      TEXTURE_HDR_RGBE  //!< shared exponent for RGB, half for other channels
+    };
+
+    /*! with a maxSize > 0 the mip chain of every texture loaded is built
+        and cached next to it, in <file>.mips; the largest level no larger
+        than maxSize is loaded. Only textures loaded after the call are
+        affected */
+    OSPMINISG_INTERFACE void setTexturePreprocessing(int maxSize, TextureHDRFormat hdrFormat = TEXTURE_HDR_RGBE);
+
     struct OSPMINISG_INTERFACE Material : public RefCount {
       struct Param : public RefCount {
         typedef enum {
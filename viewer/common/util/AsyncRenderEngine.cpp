@@ -43,6 +43,12 @@ namespace ospray {
     objsToCommit.push_back(obj.object()); 
   }
 
+  void AsyncRenderEngine::scheduleTask(std::function<void()> task)
+  {
+    std::lock_guard<std::mutex> lock{objMutex};
+    tasksToRun.push_back(task);
+  }
+
   void AsyncRenderEngine::start(int numThreads)
   {
     if (state == ExecState::RUNNING)
@@ -120,7 +126,16 @@ namespace ospray {
       commitOccurred = true;
     }
 
-    return commitOccurred;
+    // run outside of the lock, such that scheduling does not wait on them
+    std::vector<std::function<void()>> tasks;
+    {
+      std::lock_guard<std::mutex> lock{objMutex};
+      tasks.swap(tasksToRun);
+    }
+    for (auto &task : tasks)
+      task();
+
+    return commitOccurred || !tasks.empty();
   }
 
   bool AsyncRenderEngine::checkForFbResize()
@@ -18,6 +18,7 @@
 
 // std
 #include <atomic>
+#include <functional>
 #include <thread>
 #include <vector>
 
@@ -55,6 +56,10 @@ namespace ospray {
 
     void scheduleObjectCommit(const cpp::ManagedObject &obj);
 
+    // Method to run a task on the render thread before next frame //
+
+    void scheduleTask(std::function<void()> task);
+
     // Engine conrols //
 
     virtual void start(int numThreads = -1);
@@ -102,6 +107,7 @@ namespace ospray {
 
     std::mutex objMutex;
     std::vector<OSPObject> objsToCommit;
+    std::vector<std::function<void()>> tasksToRun;
 
     std::atomic<bool> newPixels {false};
 
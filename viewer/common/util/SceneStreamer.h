@@ -0,0 +1,50 @@
+// ======================================================================== //
+// Copyright 2009-2017 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+// std
+#include <functional>
+
+// ospcommon
+#include "ospcommon/vec.h"
+
+namespace ospray {
+
+  /*! replaces the proxies a scene was first committed with by the real
+      geometry in the background, in the order the view needs them */
+  class SceneStreamer
+  {
+  public:
+
+    /*! hands a task to the render thread, which runs it before the next
+        frame; the ospray API is not thread safe, so all objects are
+        created, set and committed in such tasks */
+    using ScheduleFunction = std::function<void(std::function<void()>)>;
+
+    virtual ~SceneStreamer() = default;
+
+    virtual void start(ScheduleFunction schedule) = 0;
+    virtual void stop() = 0;
+
+    /*! camera position, direction and opening angle in degrees */
+    virtual void setView(const ospcommon::vec3f &from,
+                         const ospcommon::vec3f &dir,
+                         float fovy,
+                         float aspect) = 0;
+  };
+
+}// namespace ospray
@@ -76,8 +76,10 @@ namespace exampleViewer {
 
     ospLoadModule("siggraph");
 
+    std::shared_ptr<ospray::SceneStreamer> streamer;
+    std::function<void(const ospcommon::vec2f &)> shutterWindow;
     auto ospObjs = parseCommandLine<DefaultRendererParser, DefaultCameraParser,
-      DemoSceneParser, DefaultLightsParser>(ac, av);
+      DemoSceneParser, DefaultLightsParser>(ac, av, &streamer, &shutterWindow);
 
     std::deque<ospcommon::box3f>   bbox;
     std::deque<ospray::cpp::Model> model;
@@ -94,6 +96,8 @@ namespace exampleViewer {
     window.setScale(scale);
     window.setLockFirstAnimationFrame(lockFirstFrame);
     window.setTranslation(translate);
+    window.setSceneStreamer(streamer);
+    window.setShutterWindow(shutterWindow);
     window.create("OSPRay Demo", fullscreen);
 
     ospray::imgui3D::run();
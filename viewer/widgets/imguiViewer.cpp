@@ -99,9 +99,33 @@ namespace ospray {
 
   ImGuiViewer::~ImGuiViewer()
   {
+    if (sceneStreamer)
+      sceneStreamer->stop();
     renderEngine.stop();
   }
 
+  void ImGuiViewer::setSceneStreamer(std::shared_ptr<SceneStreamer> streamer)
+  {
+    if (sceneStreamer)
+      sceneStreamer->stop();
+
+    sceneStreamer = streamer;
+    if (sceneStreamer) {
+      sceneStreamer->start([this](std::function<void()> task) {
+        renderEngine.scheduleTask(task);
+      });
+      viewPort.modified = true;
+    }
+  }
+
+  void ImGuiViewer::setShutterWindow(std::function<void(const vec2f &)> window)
+  {
+    // off by default: every change of the shutter then rebuilds all
+    // moving meshes, which only pays off for long animations
+    shutterWindow = window;
+    useShutterWindow = false;
+  }
+
   void ImGuiViewer::setRenderer(OSPRenderer renderer,
                                 OSPRenderer rendererDW,
                                 OSPFrameBuffer frameBufferDW)
@@ -247,8 +271,27 @@ namespace ospray {
       camera.set("aspect", viewPort.aspect);
       camera.set("fovy", viewPort.openingAngle);
       camera.set("handedness", viewPort.handedness);
-      camera.set("shutterOpen",viewPort.shutter.x);
-      camera.set("shutterClose",viewPort.shutter.y);
+
+      // with a shutter window, the moving meshes are rebuilt for just the
+      // shutter, which ray time [0,1] then spans
+      const bool windowed = shutterWindow && useShutterWindow;
+      const vec2f cameraShutter = windowed ? vec2f(0.f, 1.f) : viewPort.shutter;
+      camera.set("shutterOpen",cameraShutter.x);
+      camera.set("shutterClose",cameraShutter.y);
+
+      const vec2f meshShutter = windowed ? viewPort.shutter : vec2f(0.f, 1.f);
+      if (shutterWindow && meshShutter != geometryShutter) {
+        geometryShutter = meshShutter;
+        auto window = shutterWindow;
+        renderEngine.scheduleTask([window, meshShutter]() {
+          window(meshShutter);
+        });
+      }
+
+      if (sceneStreamer) {
+        sceneStreamer->setView(viewPort.from, dir,
+                               viewPort.openingAngle, viewPort.aspect);
+      }
 
       viewPort.modified = false;
       renderEngine.scheduleObjectCommit(camera);
@@ -487,6 +530,11 @@ namespace ospray {
         viewPort.modified = true;
       }
 
+      if (shutterWindow &&
+          ImGui::Checkbox("build shutter window only", &useShutterWindow)) {
+        viewPort.modified = true;
+      }
+
       if (renderer_changed) {
         renderEngine.scheduleObjectCommit(renderer);
         if (rendererDW)
@@ -27,6 +27,7 @@
 #include "ospray/ospray_cpp/Renderer.h"
 
 #include "../common/util/AsyncRenderEngine.h"
+#include "../common/util/SceneStreamer.h"
 
 #include "imgui3D.h"
 #include "Imgui3dExport.h"
@@ -64,6 +65,8 @@ namespace ospray {
     void setScale(const ospcommon::vec3f& v )  {scale = v;}
     void setTranslation(const ospcommon::vec3f& v)  {translate = v;}
     void setLockFirstAnimationFrame(bool st) {lockFirstAnimationFrame = st;}
+    void setSceneStreamer(std::shared_ptr<SceneStreamer> streamer);
+    void setShutterWindow(std::function<void(const ospcommon::vec2f &)> window);
 
   protected:
 
@@ -110,6 +113,14 @@ namespace ospray {
 
     AsyncRenderEngine renderEngine;
     std::vector<uint32_t> pixelBuffer;
+
+    std::shared_ptr<SceneStreamer> sceneStreamer;
+
+    /*! rebuilds the moving meshes for a window of their animation; while
+        in use, the camera shutter spans just that window */
+    std::function<void(const ospcommon::vec2f &)> shutterWindow;
+    bool useShutterWindow {false};
+    ospcommon::vec2f geometryShutter {0.f, 1.f}; //!< last window applied
   };
 
 }// namespace ospray